@@ -0,0 +1,391 @@
+//
+// bench.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "buffer.h"
+#include "parser.h"
+#include "visit.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include <psapi.h>
+#else
+  #include <sys/resource.h>
+#endif
+
+#define BENCH_DEFAULT_FUNCS 20000
+#define BENCH_DEFAULT_SEED  0x5eed
+#define BENCH_MAX_DEPTH     12
+
+typedef struct
+{
+  Buffer   *buf;
+  uint64_t state;
+  int      funcs;
+} Generator;
+
+static inline void print_usage(char *cmd);
+static inline uint32_t next_random(Generator *gen);
+static inline int random_below(Generator *gen, int n);
+static inline void emit(Buffer *buf, const char *chars);
+static inline void emitf(Buffer *buf, const char *fmt, ...);
+static inline void emit_close(Buffer *buf);
+static inline void gen_expr(Generator *gen, int depth);
+static inline void gen_type(Generator *gen, int depth);
+static inline void gen_comment(Generator *gen);
+static inline void gen_string(Generator *gen);
+static inline void gen_generics(Generator *gen, int index);
+static inline void gen_func(Generator *gen, int index);
+static inline void generate(Buffer *buf, int funcs, uint64_t seed);
+static inline AstVisitResult count_node(AstNode *node, int depth, void *data);
+static inline long count_nodes(AstNode *ast);
+static inline double now(void);
+static inline double peak_rss(void);
+static inline void report(const char *name, double secs, long items,
+  const char *unit, size_t bytes);
+
+static inline void print_usage(char *cmd)
+{
+  printf("\nUsage: %s [options]\n", cmd);
+  printf("\nOptions:\n");
+  printf("  -n <count>  number of functions to generate (default %d)\n",
+    BENCH_DEFAULT_FUNCS);
+  printf("  -s <seed>   seed of the generator (default %d)\n",
+    BENCH_DEFAULT_SEED);
+  printf("  -o <file>   write the generated program to a file and exit\n");
+}
+
+static inline uint32_t next_random(Generator *gen)
+{
+  // xorshift64*, so that the corpus only depends on the seed.
+  uint64_t x = gen->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  gen->state = x;
+  return (uint32_t) ((x * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+static inline int random_below(Generator *gen, int n)
+{
+  return (int) (next_random(gen) % (uint32_t) n);
+}
+
+static inline void emit(Buffer *buf, const char *chars)
+{
+  buffer_write(buf, strlen(chars), (void *) chars);
+}
+
+static inline void emitf(Buffer *buf, const char *fmt, ...)
+{
+  char chars[256];
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(chars, sizeof(chars), fmt, args);
+  va_end(args);
+  buffer_write(buf, (size_t) length, chars);
+}
+
+static inline void emit_close(Buffer *buf)
+{
+  // A '>>' would be lexed as a shift operator.
+  emit(buf, buf->data[buf->count - 1] == '>' ? " >" : ">");
+}
+
+static inline void gen_expr(Generator *gen, int depth)
+{
+  static const char *ops[] = {
+    " || ", " && ", " | ", " ^ ", " & ", " == ", " != ", " < ", " <= ",
+    " > ", " >= ", " << ", " >> ", " + ", " - ", " * ", " / ", " % "
+  };
+  Buffer *buf = gen->buf;
+  if (!depth)
+  {
+    switch (random_below(gen, 6))
+    {
+    case 0:
+      emitf(buf, "%d", random_below(gen, 100000));
+      break;
+    case 1:
+      emitf(buf, "%d.%de-%d", random_below(gen, 1000), random_below(gen, 100),
+        random_below(gen, 10));
+      break;
+    case 2:
+      emit(buf, "values[i].first");
+      break;
+    case 3:
+      emitf(buf, "f%d(a, b)", random_below(gen, gen->funcs));
+      break;
+    default:
+      emit(buf, random_below(gen, 2) ? "a" : "b");
+      break;
+    }
+    return;
+  }
+  switch (random_below(gen, 8))
+  {
+  case 0:
+    emit(buf, "(");
+    gen_expr(gen, depth - 1);
+    emit(buf, ")");
+    return;
+  case 1:
+    emit(buf, random_below(gen, 2) ? "-" : "~");
+    gen_expr(gen, depth - 1);
+    return;
+  case 2:
+    emit(buf, "if ");
+    gen_expr(gen, depth - 1);
+    emit(buf, " { ");
+    gen_expr(gen, depth - 1);
+    emit(buf, " } else { ");
+    gen_expr(gen, depth - 1);
+    emit(buf, " }");
+    return;
+  default:
+    break;
+  }
+  int n = (int) (sizeof(ops) / sizeof(*ops));
+  gen_expr(gen, depth - 1);
+  emit(buf, ops[random_below(gen, n)]);
+  gen_expr(gen, random_below(gen, depth));
+}
+
+static inline void gen_type(Generator *gen, int depth)
+{
+  static const char *names[] = { "Int", "Float", "String", "Bool", "T", "U" };
+  Buffer *buf = gen->buf;
+  int n = (int) (sizeof(names) / sizeof(*names));
+  if (!depth || random_below(gen, 3))
+  {
+    emit(buf, names[random_below(gen, n)]);
+    return;
+  }
+  emit(buf, random_below(gen, 2) ? "Map<" : "Array<");
+  gen_type(gen, depth - 1);
+  if (random_below(gen, 2))
+  {
+    emit(buf, ", ");
+    gen_type(gen, depth - 1);
+  }
+  emit_close(buf);
+}
+
+static inline void gen_comment(Generator *gen)
+{
+  Buffer *buf = gen->buf;
+  int lines = 1 + random_below(gen, 8);
+  emit(buf, "/*\n");
+  for (int i = 0; i < lines; ++i)
+    emit(buf, " * Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed\n");
+  emit(buf, " */\n");
+}
+
+static inline void gen_string(Generator *gen)
+{
+  Buffer *buf = gen->buf;
+  int words = 8 + random_below(gen, 120);
+  emit(buf, "\"");
+  for (int i = 0; i < words; ++i)
+    emit(buf, i ? " lorem" : "lorem");
+  emit(buf, "\"");
+}
+
+static inline void gen_generics(Generator *gen, int index)
+{
+  Buffer *buf = gen->buf;
+  emitf(buf, "struct Pair%d<T: Number, U> {\n  T first;\n  U second;\n}\n\n",
+    index);
+  emitf(buf, "interface Container%d<T> {\n", index);
+  emit(buf, "  Int count(Self self);\n");
+  emit(buf, "  Void insert(inout Self self, T value);\n}\n\n");
+  emitf(buf, "typealias Table%d<T> = Map<String, Array<Pair%d<T, ", index,
+    index);
+  gen_type(gen, 2);
+  emit_close(buf);
+  emit_close(buf);
+  emit_close(buf);
+  emit(buf, ";\n\n");
+}
+
+static inline void gen_func(Generator *gen, int index)
+{
+  Buffer *buf = gen->buf;
+  if (!random_below(gen, 4))
+    gen_comment(gen);
+  emit(buf, "fn ");
+  gen_type(gen, 2);
+  emitf(buf, " f%d(Int a, inout Array<Pair<Int, Float> > values, ", index);
+  gen_type(gen, 3);
+  emit(buf, " b) {\n");
+  emit(buf, "  // Line comments are skipped like any other whitespace.\n");
+  emit(buf, "  const s = ");
+  gen_string(gen);
+  emit(buf, ";\n  var Int x = ");
+  gen_expr(gen, 1 + random_below(gen, BENCH_MAX_DEPTH));
+  emit(buf, ";\n  for i in 0..a {\n    x += ");
+  gen_expr(gen, 1 + random_below(gen, BENCH_MAX_DEPTH / 2));
+  emit(buf, ";\n  }\n  if x < a {\n    return x;\n  }\n");
+  emit(buf, "  return ");
+  gen_expr(gen, 1 + random_below(gen, BENCH_MAX_DEPTH));
+  emit(buf, ";\n}\n\n");
+}
+
+static inline void generate(Buffer *buf, int funcs, uint64_t seed)
+{
+  Generator gen = {
+    .buf = buf,
+    .state = seed ? seed : BENCH_DEFAULT_SEED,
+    .funcs = funcs
+  };
+  for (int i = 0; i < funcs; ++i)
+  {
+    if (!(i % 64))
+      gen_generics(&gen, i / 64);
+    gen_func(&gen, i);
+  }
+  char padding[LEXER_PADDING] = { 0 };
+  buffer_write(buf, sizeof(padding), padding);
+}
+
+static inline AstVisitResult count_node(AstNode *node, int depth, void *data)
+{
+  (void) node;
+  (void) depth;
+  ++*(long *) data;
+  return AST_VISIT_CONTINUE;
+}
+
+static inline long count_nodes(AstNode *ast)
+{
+  long count = 0;
+  AstVisitor visitor;
+  ast_visitor_init(&visitor, &count);
+  ast_visitor_on_all(&visitor, count_node, NULL);
+  ast_visit(&visitor, ast);
+  ast_visitor_deinit(&visitor);
+  return count;
+}
+
+static inline double now(void)
+{
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static inline double peak_rss(void)
+{
+  // In MiB.
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return (double) counters.PeakWorkingSetSize / (1 << 20);
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  #ifdef __APPLE__
+  return (double) usage.ru_maxrss / (1 << 20);
+  #else
+  return (double) usage.ru_maxrss / (1 << 10);
+  #endif
+#endif
+}
+
+static inline void report(const char *name, double secs, long items,
+  const char *unit, size_t bytes)
+{
+  printf("%-7s %9.3f ms  %12.0f %s/s  %9.2f MiB/s  peak RSS %8.2f MiB\n",
+    name, secs * 1e3, (double) items / secs, unit,
+    (double) bytes / secs / (1 << 20), peak_rss());
+}
+
+int main(int argc, char *argv[])
+{
+  int funcs = BENCH_DEFAULT_FUNCS;
+  uint64_t seed = BENCH_DEFAULT_SEED;
+  char *output = NULL;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 < argc && !strcmp(argv[i], "-n"))
+    {
+      funcs = atoi(argv[++i]);
+      continue;
+    }
+    if (i + 1 < argc && !strcmp(argv[i], "-s"))
+    {
+      seed = strtoull(argv[++i], NULL, 0);
+      continue;
+    }
+    if (i + 1 < argc && !strcmp(argv[i], "-o"))
+    {
+      output = argv[++i];
+      continue;
+    }
+    fprintf(stderr, "\nERROR: unknown option %s\n", argv[i]);
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (funcs < 1)
+    funcs = 1;
+  Buffer buf;
+  buffer_init(&buf);
+  generate(&buf, funcs, seed);
+  size_t size = buf.count - LEXER_PADDING;
+  if (output)
+  {
+    FILE *fp = fopen(output, "wb");
+    if (!fp || fwrite(buf.data, 1, size, fp) != size)
+    {
+      fprintf(stderr, "\nERROR: cannot write file %s\n", output);
+      return EXIT_FAILURE;
+    }
+    fclose(fp);
+    return EXIT_SUCCESS;
+  }
+  printf("corpus: %d functions, %.2f MiB\n", funcs, (double) size / (1 << 20));
+  Interner interner;
+  interner_init(&interner);
+  DiagList diags;
+  diag_init(&diags);
+  Lexer lex;
+  long tokens = 1;
+  double start = now();
+  lexer_init(&lex, "<bench>", buf.data, &interner, &diags);
+  for (; lex.kind != TOKEN_KIND_EOF; ++tokens)
+    lexer_next(&lex);
+  double lexSecs = now() - start;
+  report("lexer", lexSecs, tokens, "tokens", size);
+  Parser parser;
+  start = now();
+  parser_init(&parser, "<bench>", buf.data, &interner, 0);
+  AstNode *ast = parser_parse(&parser);
+  double parseSecs = now() - start;
+  long nodes = count_nodes(ast);
+  report("parser", parseSecs, nodes, "nodes", size);
+  start = now();
+  count_nodes(ast);
+  double visitSecs = now() - start;
+  report("visit", visitSecs, nodes, "nodes", size);
+  parser_deinit(&parser);
+  start = now();
+  parser_init(&parser, "<bench>", buf.data, &interner, PARSER_FLAG_LAZY_BODIES);
+  ast = parser_parse(&parser);
+  double declSecs = now() - start;
+  report("decls", declSecs, count_nodes(ast), "nodes", size);
+  parser_deinit(&parser);
+  return EXIT_SUCCESS;
+}
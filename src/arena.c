@@ -0,0 +1,65 @@
+//
+// arena.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "arena.h"
+#include <stdlib.h>
+
+static inline ArenaChunk *chunk_new(size_t capacity, ArenaChunk *next);
+
+static inline ArenaChunk *chunk_new(size_t capacity, ArenaChunk *next)
+{
+  ArenaChunk *chunk = malloc(sizeof(*chunk) + capacity);
+  chunk->next = next;
+  chunk->capacity = capacity;
+  chunk->count = 0;
+  chunk->data = (char *) &chunk[1];
+  return chunk;
+}
+
+void arena_init(Arena *arena)
+{
+  arena->chunk = NULL;
+}
+
+void arena_deinit(Arena *arena)
+{
+  ArenaChunk *chunk = arena->chunk;
+  while (chunk)
+  {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->chunk = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+  size = (size + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+  ArenaChunk *chunk = arena->chunk;
+  if (!chunk || chunk->count + size > chunk->capacity)
+  {
+    // Oversized requests get a chunk of their own, placed behind the
+    // current one so that its free space is not thrown away.
+    if (size > ARENA_CHUNK_SIZE >> 2 && chunk)
+    {
+      ArenaChunk *big = chunk_new(size, chunk->next);
+      chunk->next = big;
+      big->count = size;
+      return big->data;
+    }
+    size_t capacity = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+    chunk = chunk_new(capacity, chunk);
+    arena->chunk = chunk;
+  }
+  void *ptr = &chunk->data[chunk->count];
+  chunk->count += size;
+  return ptr;
+}
@@ -0,0 +1,36 @@
+//
+// arena.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (1 << 16)
+#define ARENA_ALIGNMENT  8
+
+typedef struct ArenaChunk
+{
+  struct ArenaChunk *next;
+  size_t            capacity;
+  size_t            count;
+  char              *data;
+} ArenaChunk;
+
+typedef struct
+{
+  ArenaChunk *chunk;
+} Arena;
+
+void arena_init(Arena *arena);
+void arena_deinit(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+
+#endif // ARENA_H
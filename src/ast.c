@@ -12,114 +12,417 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "buffer.h"
 
-static inline void node_print(AstNode *node, int level);
+#define write_literal(p, s) printer_write((p), sizeof(s) - 1, (s))
 
-static inline void node_print(AstNode *node, int level)
+typedef struct
+{
+  AstNode  *node;
+  uint32_t index;
+  int      next;
+} PrintFrame;
+
+// Printing keeps its own stack of open non-leaf nodes, so that deep trees
+// do not exhaust the call stack, and writes into a buffer that is flushed
+// in large chunks, either to a stream or to the end of another buffer.
+typedef struct
+{
+  AstPrintFormat format;
+  const char     *text;
+  FILE           *stream;
+  Buffer         *out;
+  Buffer         buf;
+  int            capacity;
+  int            count;
+  PrintFrame     *frames;
+} Printer;
+
+typedef struct
+{
+  AstNonLeafNode *node;
+  uint32_t       index;
+  int            next;
+} FlattenFrame;
+
+static inline void printer_init(Printer *printer, const char *text,
+  AstPrintFormat format, FILE *stream, Buffer *out);
+static inline void printer_deinit(Printer *printer);
+static inline void printer_flush(Printer *printer);
+static inline void printer_write(Printer *printer, size_t count,
+  const char *chars);
+static inline void printer_push(Printer *printer, AstNode *node,
+  uint32_t index);
+static inline bool has_text(AstNodeKind kind);
+static inline void print_prefix(Printer *printer, int level, bool first);
+static inline void print_json_string(Printer *printer, size_t length,
+  const char *chars);
+static inline void print_null(Printer *printer, int level, bool first);
+static inline void print_leaf(Printer *printer, AstNodeKind kind, Token *token,
+  int level, bool first);
+static inline void print_open(Printer *printer, AstNodeKind kind, int level,
+  bool first);
+static inline void print_close(Printer *printer);
+static inline void tree_visit(Printer *printer, AstNode *node, int level,
+  bool first);
+static inline void tree_print(Printer *printer, AstNode *ast);
+static inline void flat_visit(Printer *printer, AstFlat *flat, uint32_t index,
+  int level, bool first);
+static inline void flat_print(Printer *printer, AstFlat *flat);
+static inline uint32_t flatten_node(AstFlat *flat, AstNode *node);
+static inline uint32_t flatten(AstFlat *flat, AstNode *ast);
+
+static inline void printer_init(Printer *printer, const char *text,
+  AstPrintFormat format, FILE *stream, Buffer *out)
+{
+  printer->format = format;
+  printer->text = text;
+  printer->stream = stream;
+  printer->out = out;
+  buffer_init_with_capacity(&printer->buf, AST_PRINT_FLUSH_SIZE << 1);
+  int capacity = AST_PRINT_MIN_DEPTH;
+  printer->capacity = capacity;
+  printer->count = 0;
+  printer->frames = malloc(sizeof(*printer->frames) * capacity);
+}
+
+static inline void printer_deinit(Printer *printer)
+{
+  printer_flush(printer);
+  if (printer->stream)
+    fflush(printer->stream);
+  free(printer->buf.data);
+  free(printer->frames);
+}
+
+static inline void printer_flush(Printer *printer)
+{
+  Buffer *buf = &printer->buf;
+  if (buffer_is_empty(buf))
+    return;
+  if (printer->out)
+    buffer_write(printer->out, buf->count, buf->data);
+  else
+    fwrite(buf->data, 1, buf->count, printer->stream);
+  buffer_clear(buf);
+}
+
+static inline void printer_write(Printer *printer, size_t count,
+  const char *chars)
+{
+  buffer_write(&printer->buf, count, (void *) chars);
+}
+
+static inline void printer_push(Printer *printer, AstNode *node,
+  uint32_t index)
+{
+  if (printer->count == printer->capacity)
+  {
+    int newCapacity = printer->capacity << 1;
+    printer->frames = realloc(printer->frames,
+      sizeof(*printer->frames) * newCapacity);
+    printer->capacity = newCapacity;
+  }
+  PrintFrame *frame = &printer->frames[printer->count];
+  frame->node = node;
+  frame->index = index;
+  frame->next = 0;
+  ++printer->count;
+}
+
+static inline bool has_text(AstNodeKind kind)
+{
+  return kind == AST_NODE_KIND_INT || kind == AST_NODE_KIND_FLOAT
+    || kind == AST_NODE_KIND_CHAR || kind == AST_NODE_KIND_STRING
+    || kind == AST_NODE_KIND_IDENT;
+}
+
+static inline void print_prefix(Printer *printer, int level, bool first)
+{
+  Buffer *buf = &printer->buf;
+  if (printer->format == AST_PRINT_FORMAT_JSON)
+  {
+    if (!first)
+      write_literal(printer, ",");
+    return;
+  }
+  // Text is written per node, so a flush here keeps the buffer bounded.
+  if (buf->count >= AST_PRINT_FLUSH_SIZE)
+    printer_flush(printer);
+  size_t count = (size_t) level << 1;
+  buffer_ensure_capacity(buf, buf->count + count);
+  memset(&buf->data[buf->count], ' ', count);
+  buf->count += count;
+}
+
+static inline void print_json_string(Printer *printer, size_t length,
+  const char *chars)
+{
+  Buffer *buf = &printer->buf;
+  write_literal(printer, "\"");
+  size_t start = 0;
+  for (size_t i = 0; i < length; ++i)
+  {
+    unsigned char c = (unsigned char) chars[i];
+    if (c >= 0x20 && c != '\"' && c != '\\')
+      continue;
+    printer_write(printer, i - start, &chars[start]);
+    start = i + 1;
+    char escape[8] = { '\\', (char) c };
+    int count = 2;
+    if (c < 0x20)
+      count = snprintf(escape, sizeof(escape), "\\u%04x", c);
+    buffer_write(buf, (size_t) count, escape);
+  }
+  printer_write(printer, length - start, &chars[start]);
+  write_literal(printer, "\"");
+}
+
+static inline void print_null(Printer *printer, int level, bool first)
+{
+  print_prefix(printer, level, first);
+  if (printer->format == AST_PRINT_FORMAT_JSON)
+  {
+    write_literal(printer, "null");
+    return;
+  }
+  write_literal(printer, "(null)\n");
+}
+
+static inline void print_leaf(Printer *printer, AstNodeKind kind, Token *token,
+  int level, bool first)
+{
+  const char *name = ast_node_kind_name(kind);
+  size_t length = strlen(name);
+  bool hasText = has_text(kind);
+  const char *chars = &printer->text[token->offset];
+  print_prefix(printer, level, first);
+  if (printer->format == AST_PRINT_FORMAT_JSON)
+  {
+    write_literal(printer, "{\"kind\":\"");
+    printer_write(printer, length, name);
+    if (!hasText)
+    {
+      write_literal(printer, "\"}");
+      return;
+    }
+    write_literal(printer, "\",\"text\":");
+    print_json_string(printer, token->length, chars);
+    write_literal(printer, "}");
+    return;
+  }
+  printer_write(printer, length, name);
+  if (hasText)
+  {
+    write_literal(printer, ": ");
+    printer_write(printer, token->length, chars);
+  }
+  write_literal(printer, "\n");
+}
+
+static inline void print_open(Printer *printer, AstNodeKind kind, int level,
+  bool first)
+{
+  const char *name = ast_node_kind_name(kind);
+  size_t length = strlen(name);
+  print_prefix(printer, level, first);
+  if (printer->format == AST_PRINT_FORMAT_JSON)
+  {
+    write_literal(printer, "{\"kind\":\"");
+    printer_write(printer, length, name);
+    write_literal(printer, "\",\"children\":[");
+    return;
+  }
+  printer_write(printer, length, name);
+  write_literal(printer, ":\n");
+}
+
+static inline void print_close(Printer *printer)
+{
+  if (printer->format != AST_PRINT_FORMAT_JSON)
+    return;
+  write_literal(printer, "]}");
+  // JSON nodes close in bursts, so the flush goes here instead.
+  if (printer->buf.count >= AST_PRINT_FLUSH_SIZE)
+    printer_flush(printer);
+}
+
+static inline void tree_visit(Printer *printer, AstNode *node, int level,
+  bool first)
 {
-  for (int i = 0; i < level; ++i) printf("  ");
   if (!node)
   {
-    printf("(null)\n");
+    print_null(printer, level, first);
     return;
   }
   AstNodeKind kind = node->kind;
-  const char *name = ast_node_kind_name(kind);
-  switch (kind)
+  if (ast_node_is_leaf(kind))
+  {
+    AstLeafNode *leaf = (AstLeafNode *) node;
+    print_leaf(printer, kind, &leaf->token, level, first);
+    return;
+  }
+  print_open(printer, kind, level, first);
+  printer_push(printer, node, 0);
+}
+
+static inline void tree_print(Printer *printer, AstNode *ast)
+{
+  tree_visit(printer, ast, 0, true);
+  while (printer->count)
   {
-  case AST_NODE_KIND_MODULE:
-  case AST_NODE_KIND_IMPORT_DECL:
-  case AST_NODE_KIND_RENAME:
-  case AST_NODE_KIND_TYPEALIAS_DECL:
-  case AST_NODE_KIND_POLY_PARAMS:
-  case AST_NODE_KIND_CONSTRAINT:
-  case AST_NODE_KIND_FUNC_DECL:
-  case AST_NODE_KIND_PARAMS:
-  case AST_NODE_KIND_INOUT_PARAM:
-  case AST_NODE_KIND_STRUCT_DECL:
-  case AST_NODE_KIND_INTERFACE_DECL:
-  case AST_NODE_KIND_VAR_DECL:
-  case AST_NODE_KIND_CONST_DECL:
-  case AST_NODE_KIND_REF:
-  case AST_NODE_KIND_FUNC_TYPE:
-  case AST_NODE_KIND_TYPE:
-  case AST_NODE_KIND_BLOCK:
-  case AST_NODE_KIND_ASSIGN:
-  case AST_NODE_KIND_BOR_ASSIGN:
-  case AST_NODE_KIND_BXOR_ASSIGN:
-  case AST_NODE_KIND_BAND_ASSIGN:
-  case AST_NODE_KIND_SHL_ASSIGN:
-  case AST_NODE_KIND_SHR_ASSIGN:
-  case AST_NODE_KIND_ADD_ASSIGN:
-  case AST_NODE_KIND_SUB_ASSIGN:
-  case AST_NODE_KIND_MUL_ASSIGN:
-  case AST_NODE_KIND_DIV_ASSIGN:
-  case AST_NODE_KIND_MOD_ASSIGN:
-  case AST_NODE_KIND_IF:
-  case AST_NODE_KIND_SWITCH:
-  case AST_NODE_KIND_CASE:
-  case AST_NODE_KIND_DEFAULT:
-  case AST_NODE_KIND_WHILE:
-  case AST_NODE_KIND_DO_WHILE:
-  case AST_NODE_KIND_FOR:
-  case AST_NODE_KIND_RETURN:
-  case AST_NODE_KIND_OR:
-  case AST_NODE_KIND_AND:
-  case AST_NODE_KIND_EQ:
-  case AST_NODE_KIND_NE:
-  case AST_NODE_KIND_LT:
-  case AST_NODE_KIND_LE:
-  case AST_NODE_KIND_GT:
-  case AST_NODE_KIND_GE:
-  case AST_NODE_KIND_BOR:
-  case AST_NODE_KIND_BXOR:
-  case AST_NODE_KIND_BAND:
-  case AST_NODE_KIND_SHL:
-  case AST_NODE_KIND_SHR:
-  case AST_NODE_KIND_RANGE:
-  case AST_NODE_KIND_ADD:
-  case AST_NODE_KIND_SUB:
-  case AST_NODE_KIND_MUL:
-  case AST_NODE_KIND_DIV:
-  case AST_NODE_KIND_MOD:
-  case AST_NODE_KIND_NOT:
-  case AST_NODE_KIND_NEG:
-  case AST_NODE_KIND_BNOT:
-  case AST_NODE_KIND_NEW:
-  case AST_NODE_KIND_TRY:
-  case AST_NODE_KIND_CALL:
-  case AST_NODE_KIND_ARRAY:
-  case AST_NODE_KIND_ELEMENT:
-  case AST_NODE_KIND_FIELD:
+    PrintFrame *frame = &printer->frames[printer->count - 1];
+    AstNonLeafNode *nonleaf = (AstNonLeafNode *) frame->node;
+    if (frame->next == nonleaf->count)
     {
-      AstNonLeafNode *nonleaf = (AstNonLeafNode *) node;
-      printf("%s:\n", name);
-      for (int i = 0; i < nonleaf->count; ++i)
-      {
-        AstNode *child = nonleaf->children[i];
-        node_print(child, level + 1);
-      }
+      print_close(printer);
+      --printer->count;
+      continue;
     }
-    break;
-  case AST_NODE_KIND_BREAK:
-  case AST_NODE_KIND_CONTINUE:
-  case AST_NODE_KIND_VOID:
-  case AST_NODE_KIND_FALSE:
-  case AST_NODE_KIND_TRUE:
-    printf("%s\n", name);
-    break;
-  case AST_NODE_KIND_INT:
-  case AST_NODE_KIND_FLOAT:
-  case AST_NODE_KIND_CHAR:
-  case AST_NODE_KIND_STRING:
-  case AST_NODE_KIND_IDENT:
+    int i = frame->next++;
+    tree_visit(printer, nonleaf->children[i], printer->count, !i);
+  }
+}
+
+static inline void flat_visit(Printer *printer, AstFlat *flat, uint32_t index,
+  int level, bool first)
+{
+  if (index == AST_FLAT_NONE)
+  {
+    print_null(printer, level, first);
+    return;
+  }
+  AstNodeKind kind = (AstNodeKind) flat->kinds[index];
+  if (ast_node_is_leaf(kind))
+  {
+    Token *token = &flat->tokens[flat->mainTokens[index]];
+    print_leaf(printer, kind, token, level, first);
+    return;
+  }
+  print_open(printer, kind, level, first);
+  printer_push(printer, NULL, index);
+}
+
+static inline void flat_print(Printer *printer, AstFlat *flat)
+{
+  flat_visit(printer, flat, 0, 0, true);
+  while (printer->count)
+  {
+    PrintFrame *frame = &printer->frames[printer->count - 1];
+    uint32_t index = frame->index;
+    if (frame->next == (int) flat->childCounts[index])
     {
-      AstLeafNode *leaf = (AstLeafNode *) node;
-      Token *token = &leaf->token;
-      printf("%s: %.*s\n",name, token->length, token->chars);
+      print_close(printer);
+      --printer->count;
+      continue;
     }
-    break;
+    int i = frame->next++;
+    uint32_t child = flat->extra[flat->childStarts[index] + i];
+    flat_visit(printer, flat, child, printer->count, !i);
+  }
+}
+
+static inline uint32_t flatten_node(AstFlat *flat, AstNode *node)
+{
+  // Appends the node alone; the indices of its children are filled in by
+  // flatten as they are appended in turn.
+  if (!node)
+    return AST_FLAT_NONE;
+  if (flat->count == flat->capacity)
+  {
+    int newCapacity = flat->capacity << 1;
+    flat->kinds = realloc(flat->kinds, sizeof(*flat->kinds) * newCapacity);
+    flat->mainTokens = realloc(flat->mainTokens, sizeof(*flat->mainTokens) * newCapacity);
+    flat->childStarts = realloc(flat->childStarts, sizeof(*flat->childStarts) * newCapacity);
+    flat->childCounts = realloc(flat->childCounts, sizeof(*flat->childCounts) * newCapacity);
+    flat->capacity = newCapacity;
+  }
+  uint32_t index = (uint32_t) flat->count;
+  ++flat->count;
+  AstNodeKind kind = node->kind;
+  flat->kinds[index] = (uint8_t) kind;
+  flat->childStarts[index] = 0;
+  flat->childCounts[index] = 0;
+  if (ast_node_is_leaf(kind))
+  {
+    if (flat->tokenCount == flat->tokenCapacity)
+    {
+      int newCapacity = flat->tokenCapacity << 1;
+      flat->tokens = realloc(flat->tokens, sizeof(*flat->tokens) * newCapacity);
+      flat->values = realloc(flat->values, sizeof(*flat->values) * newCapacity);
+      flat->tokenCapacity = newCapacity;
+    }
+    AstLeafNode *leaf = (AstLeafNode *) node;
+    flat->tokens[flat->tokenCount] = leaf->token;
+    flat->values[flat->tokenCount] = leaf->value;
+    flat->mainTokens[index] = (uint32_t) flat->tokenCount;
+    ++flat->tokenCount;
+    return index;
+  }
+  AstNonLeafNode *nonleaf = (AstNonLeafNode *) node;
+  int count = nonleaf->count;
+  int start = flat->extraCount;
+  int capacity = flat->extraCapacity;
+  while (capacity < start + count)
+    capacity <<= 1;
+  if (capacity > flat->extraCapacity)
+  {
+    flat->extra = realloc(flat->extra, sizeof(*flat->extra) * capacity);
+    flat->extraCapacity = capacity;
+  }
+  flat->extraCount += count;
+  flat->mainTokens[index] = AST_FLAT_NONE;
+  flat->childStarts[index] = (uint32_t) start;
+  flat->childCounts[index] = (uint32_t) count;
+  return index;
+}
+
+static inline uint32_t flatten(AstFlat *flat, AstNode *ast)
+{
+  // Like printing, flattening keeps its own stack of open non-leaf nodes,
+  // so that deep trees do not exhaust the call stack. Nodes are appended in
+  // the same preorder a recursive walk would give.
+  uint32_t root = flatten_node(flat, ast);
+  if (!ast || ast_node_is_leaf(ast->kind))
+    return root;
+  int capacity = AST_FLAT_MIN_CAPACITY;
+  FlattenFrame *frames = malloc(sizeof(*frames) * capacity);
+  frames[0] = (FlattenFrame) {
+    .node = (AstNonLeafNode *) ast,
+    .index = root,
+    .next = 0
+  };
+  int count = 1;
+  while (count)
+  {
+    FlattenFrame *frame = &frames[count - 1];
+    AstNonLeafNode *nonleaf = frame->node;
+    if (frame->next == nonleaf->count)
+    {
+      --count;
+      continue;
+    }
+    int i = frame->next++;
+    uint32_t parent = frame->index;
+    AstNode *node = nonleaf->children[i];
+    uint32_t child = flatten_node(flat, node);
+    flat->extra[flat->childStarts[parent] + i] = child;
+    if (!node || ast_node_is_leaf(node->kind))
+      continue;
+    if (count == capacity)
+    {
+      capacity <<= 1;
+      frames = realloc(frames, sizeof(*frames) * capacity);
+    }
+    frames[count++] = (FlattenFrame) {
+      .node = (AstNonLeafNode *) node,
+      .index = child,
+      .next = 0
+    };
   }
+  free(frames);
+  return root;
 }
 
 const char *ast_node_kind_name(AstNodeKind kind)
@@ -201,24 +504,51 @@ const char *ast_node_kind_name(AstNodeKind kind)
   case AST_NODE_KIND_ELEMENT:        name = "Element";       break;
   case AST_NODE_KIND_FIELD:          name = "Field";         break;
   case AST_NODE_KIND_IDENT:          name = "Ident";         break;
+  case AST_NODE_KIND_ERROR:          name = "Error";         break;
+  case AST_NODE_KIND_LAZY_BLOCK:     name = "LazyBlock";     break;
   }
   assert(name);
   return name;
 }
 
-AstLeafNode *ast_leaf_node_new(AstNodeKind kind, Token token)
+bool ast_node_is_leaf(AstNodeKind kind)
 {
-  AstLeafNode *node = malloc(sizeof(*node));
+  switch (kind)
+  {
+  case AST_NODE_KIND_BREAK:
+  case AST_NODE_KIND_CONTINUE:
+  case AST_NODE_KIND_VOID:
+  case AST_NODE_KIND_FALSE:
+  case AST_NODE_KIND_TRUE:
+  case AST_NODE_KIND_INT:
+  case AST_NODE_KIND_FLOAT:
+  case AST_NODE_KIND_CHAR:
+  case AST_NODE_KIND_STRING:
+  case AST_NODE_KIND_IDENT:
+  case AST_NODE_KIND_ERROR:
+  case AST_NODE_KIND_LAZY_BLOCK:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+AstLeafNode *ast_leaf_node_new(Arena *arena, AstNodeKind kind, Token token,
+  TokenValue value)
+{
+  AstLeafNode *node = arena_alloc(arena, sizeof(*node));
   node->kind = kind;
   node->token = token;
+  node->value = value;
   return node;
 }
 
-AstNonLeafNode *ast_nonleaf_node_new(AstNodeKind kind)
+AstNonLeafNode *ast_nonleaf_node_new(Arena *arena, AstNodeKind kind)
 {
   int capacity = 1;
-  AstNode **children = malloc(sizeof(*children) * capacity);
-  AstNonLeafNode *node = malloc(sizeof(*node));
+  AstNode **children = arena_alloc(arena, sizeof(*children) * capacity);
+  AstNonLeafNode *node = arena_alloc(arena, sizeof(*node));
   node->kind = kind;
   node->capacity = capacity;
   node->count = 0;
@@ -226,12 +556,28 @@ AstNonLeafNode *ast_nonleaf_node_new(AstNodeKind kind)
   return node;
 }
 
-void ast_nonleaf_node_append_child(AstNonLeafNode *node, AstNode *child)
+AstNonLeafNode *ast_nonleaf_node_new_with_children(Arena *arena, AstNodeKind kind,
+  int count, AstNode **children)
+{
+  AstNode **newChildren = arena_alloc(arena, sizeof(*newChildren) * count);
+  memcpy(newChildren, children, sizeof(*newChildren) * count);
+  AstNonLeafNode *node = arena_alloc(arena, sizeof(*node));
+  node->kind = kind;
+  node->capacity = count;
+  node->count = count;
+  node->children = newChildren;
+  return node;
+}
+
+void ast_nonleaf_node_append_child(Arena *arena, AstNonLeafNode *node,
+  AstNode *child)
 {
   if (node->count == node->capacity)
   {
-    int newCapacity = node->capacity << 1;
-    AstNode **newChildren = realloc(node->children, sizeof(*newChildren) * newCapacity);
+    // The old array stays in the arena until the whole tree is released.
+    int newCapacity = node->capacity ? node->capacity << 1 : 1;
+    AstNode **newChildren = arena_alloc(arena, sizeof(*newChildren) * newCapacity);
+    memcpy(newChildren, node->children, sizeof(*newChildren) * node->count);
     node->capacity = newCapacity;
     node->children = newChildren;
   }
@@ -239,7 +585,80 @@ void ast_nonleaf_node_append_child(AstNonLeafNode *node, AstNode *child)
   ++node->count;
 }
 
-void ast_print(AstNode *ast)
+void ast_print(AstNode *ast, const char *text, AstPrintFormat format,
+  FILE *stream)
+{
+  Printer printer;
+  printer_init(&printer, text, format, stream, NULL);
+  tree_print(&printer, ast);
+  if (format == AST_PRINT_FORMAT_JSON)
+    write_literal(&printer, "\n");
+  printer_deinit(&printer);
+}
+
+void ast_print_buffer(AstNode *ast, const char *text, AstPrintFormat format,
+  Buffer *out)
+{
+  Printer printer;
+  printer_init(&printer, text, format, NULL, out);
+  tree_print(&printer, ast);
+  if (format == AST_PRINT_FORMAT_JSON)
+    write_literal(&printer, "\n");
+  printer_deinit(&printer);
+}
+
+void ast_flat_init(AstFlat *flat)
+{
+  int capacity = AST_FLAT_MIN_CAPACITY;
+  flat->capacity = capacity;
+  flat->count = 0;
+  flat->kinds = malloc(sizeof(*flat->kinds) * capacity);
+  flat->mainTokens = malloc(sizeof(*flat->mainTokens) * capacity);
+  flat->childStarts = malloc(sizeof(*flat->childStarts) * capacity);
+  flat->childCounts = malloc(sizeof(*flat->childCounts) * capacity);
+  flat->extraCapacity = capacity;
+  flat->extraCount = 0;
+  flat->extra = malloc(sizeof(*flat->extra) * capacity);
+  flat->tokenCapacity = capacity;
+  flat->tokenCount = 0;
+  flat->tokens = malloc(sizeof(*flat->tokens) * capacity);
+  flat->values = malloc(sizeof(*flat->values) * capacity);
+}
+
+void ast_flat_deinit(AstFlat *flat)
+{
+  free(flat->kinds);
+  free(flat->mainTokens);
+  free(flat->childStarts);
+  free(flat->childCounts);
+  free(flat->extra);
+  free(flat->tokens);
+  free(flat->values);
+}
+
+uint32_t ast_flatten(AstFlat *flat, AstNode *ast)
+{
+  return flatten(flat, ast);
+}
+
+void ast_flat_print(AstFlat *flat, const char *text, AstPrintFormat format,
+  FILE *stream)
+{
+  Printer printer;
+  printer_init(&printer, text, format, stream, NULL);
+  flat_print(&printer, flat);
+  if (format == AST_PRINT_FORMAT_JSON)
+    write_literal(&printer, "\n");
+  printer_deinit(&printer);
+}
+
+void ast_flat_print_buffer(AstFlat *flat, const char *text,
+  AstPrintFormat format, Buffer *out)
 {
-  node_print(ast, 0);
+  Printer printer;
+  printer_init(&printer, text, format, NULL, out);
+  flat_print(&printer, flat);
+  if (format == AST_PRINT_FORMAT_JSON)
+    write_literal(&printer, "\n");
+  printer_deinit(&printer);
 }
@@ -11,10 +11,21 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "arena.h"
+#include "buffer.h"
 #include "lexer.h"
 
 #define AST_NODE_HEADER AstNodeKind kind;
 
+#define AST_FLAT_MIN_CAPACITY (1 << 8)
+#define AST_FLAT_NONE         UINT32_MAX
+
+#define AST_PRINT_MIN_DEPTH  (1 << 6)
+#define AST_PRINT_FLUSH_SIZE (1 << 16)
+
 typedef enum
 {
   AST_NODE_KIND_MODULE,         AST_NODE_KIND_IMPORT_DECL,    AST_NODE_KIND_RENAME,
@@ -41,9 +52,21 @@ typedef enum
   AST_NODE_KIND_VOID,           AST_NODE_KIND_FALSE,          AST_NODE_KIND_TRUE,
   AST_NODE_KIND_INT,            AST_NODE_KIND_FLOAT,          AST_NODE_KIND_CHAR,
   AST_NODE_KIND_STRING,         AST_NODE_KIND_ARRAY,          AST_NODE_KIND_ELEMENT,
-  AST_NODE_KIND_FIELD,          AST_NODE_KIND_IDENT
+  AST_NODE_KIND_FIELD,          AST_NODE_KIND_IDENT,          AST_NODE_KIND_ERROR,
+  AST_NODE_KIND_LAZY_BLOCK
 } AstNodeKind;
 
+#define AST_NODE_KIND_COUNT (AST_NODE_KIND_LAZY_BLOCK + 1)
+
+// Text is the indented dump; JSON is a single line where a non-leaf node
+// is {"kind":...,"children":[...]}, a leaf is {"kind":...} plus "text"
+// for literals and identifiers, and an absent child is null.
+typedef enum
+{
+  AST_PRINT_FORMAT_TEXT,
+  AST_PRINT_FORMAT_JSON
+} AstPrintFormat;
+
 typedef struct
 {
   AST_NODE_HEADER
@@ -52,7 +75,8 @@ typedef struct
 typedef struct
 {
   AST_NODE_HEADER
-  Token token;
+  Token      token;
+  TokenValue value;
 } AstLeafNode;
 
 typedef struct
@@ -63,10 +87,48 @@ typedef struct
   AstNode **children;
 } AstNonLeafNode;
 
+// Flat encoding of a tree: node i has kind kinds[i] and, for leaves, the
+// main token tokens[mainTokens[i]] with value values[mainTokens[i]]. The
+// children of a non-leaf node are the node indices
+// extra[childStarts[i]..childStarts[i] + childCounts[i]), where
+// AST_FLAT_NONE stands for an absent child. Nodes are stored in preorder,
+// so the root is node 0.
+typedef struct
+{
+  int        capacity;
+  int        count;
+  uint8_t    *kinds;
+  uint32_t   *mainTokens;
+  uint32_t   *childStarts;
+  uint32_t   *childCounts;
+  int        extraCapacity;
+  int        extraCount;
+  uint32_t   *extra;
+  int        tokenCapacity;
+  int        tokenCount;
+  Token      *tokens;
+  TokenValue *values;
+} AstFlat;
+
 const char *ast_node_kind_name(AstNodeKind kind);
-AstLeafNode *ast_leaf_node_new(AstNodeKind kind, Token token);
-AstNonLeafNode *ast_nonleaf_node_new(AstNodeKind kind);
-void ast_nonleaf_node_append_child(AstNonLeafNode *node, AstNode *child);
-void ast_print(AstNode *ast);
+bool ast_node_is_leaf(AstNodeKind kind);
+AstLeafNode *ast_leaf_node_new(Arena *arena, AstNodeKind kind, Token token,
+  TokenValue value);
+AstNonLeafNode *ast_nonleaf_node_new(Arena *arena, AstNodeKind kind);
+AstNonLeafNode *ast_nonleaf_node_new_with_children(Arena *arena, AstNodeKind kind,
+  int count, AstNode **children);
+void ast_nonleaf_node_append_child(Arena *arena, AstNonLeafNode *node,
+  AstNode *child);
+void ast_print(AstNode *ast, const char *text, AstPrintFormat format,
+  FILE *stream);
+void ast_print_buffer(AstNode *ast, const char *text, AstPrintFormat format,
+  Buffer *out);
+void ast_flat_init(AstFlat *flat);
+void ast_flat_deinit(AstFlat *flat);
+uint32_t ast_flatten(AstFlat *flat, AstNode *ast);
+void ast_flat_print(AstFlat *flat, const char *text, AstPrintFormat format,
+  FILE *stream);
+void ast_flat_print_buffer(AstFlat *flat, const char *text,
+  AstPrintFormat format, Buffer *out);
 
 #endif // AST_H
@@ -0,0 +1,134 @@
+//
+// batch.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "batch.h"
+#include <stdlib.h>
+
+static void write_diag(const Diagnostic *diag, void *data);
+static inline void compile_item(Batch *batch, Context *ctx, BatchItem *item);
+static void work(void *data);
+
+static void write_diag(const Diagnostic *diag, void *data)
+{
+  diag_write_buffer(diag, (Buffer *) data);
+}
+
+static inline void compile_item(Batch *batch, Context *ctx, BatchItem *item)
+{
+  buffer_init(&item->out);
+  buffer_init(&item->err);
+  if (ctx->interner.count >= BATCH_MAX_SYMBOLS)
+    context_reset(ctx);
+  context_set_sink(ctx, write_diag, &item->err);
+  ContextStatus status = context_parse_file(ctx, item->file);
+  item->failed = status != CONTEXT_STATUS_OK;
+  if (status == CONTEXT_STATUS_IO_ERROR)
+    buffer_format(&item->err, "\nERROR: cannot open file %s\n", item->file);
+  if (item->failed)
+    return;
+  if (!batch->flat)
+  {
+    ast_print_buffer(ctx->ast, context_text(ctx), batch->format, &item->out);
+    return;
+  }
+  AstFlat flat;
+  ast_flat_init(&flat);
+  ast_flatten(&flat, ctx->ast);
+  ast_flat_print_buffer(&flat, context_text(ctx), batch->format, &item->out);
+  ast_flat_deinit(&flat);
+}
+
+static void work(void *data)
+{
+  Batch *batch = data;
+  Context ctx;
+  context_init(&ctx, batch->flags);
+  mutex_lock(&batch->lock);
+  while (batch->next < batch->count)
+  {
+    BatchItem *item = &batch->items[batch->next++];
+    mutex_unlock(&batch->lock);
+    compile_item(batch, &ctx, item);
+    mutex_lock(&batch->lock);
+    item->done = true;
+    cond_signal(&batch->ready);
+  }
+  mutex_unlock(&batch->lock);
+  context_deinit(&ctx);
+}
+
+void batch_init(Batch *batch, int flags, bool flat, AstPrintFormat format)
+{
+  int capacity = BATCH_MIN_CAPACITY;
+  batch->flags = flags;
+  batch->flat = flat;
+  batch->format = format;
+  mutex_init(&batch->lock);
+  cond_init(&batch->ready);
+  batch->capacity = capacity;
+  batch->count = 0;
+  batch->items = malloc(sizeof(*batch->items) * capacity);
+  batch->next = 0;
+}
+
+void batch_deinit(Batch *batch)
+{
+  mutex_deinit(&batch->lock);
+  cond_deinit(&batch->ready);
+  free(batch->items);
+}
+
+void batch_add(Batch *batch, char *file)
+{
+  if (batch->count == batch->capacity)
+  {
+    int capacity = batch->capacity << 1;
+    batch->items = realloc(batch->items, sizeof(*batch->items) * capacity);
+    batch->capacity = capacity;
+  }
+  batch->items[batch->count++] = (BatchItem) {
+    .file = file,
+    .done = false,
+    .failed = false
+  };
+}
+
+bool batch_run(Batch *batch, int threadCount, FILE *out, FILE *err)
+{
+  // The calling thread only writes output, waiting for each file in turn
+  // while the workers move ahead.
+  Thread *threads = malloc(sizeof(*threads) * threadCount);
+  int count = 0;
+  for (int i = 0; i < threadCount; ++i)
+    if (thread_start(&threads[count], work, batch))
+      ++count;
+  if (!count)
+    work(batch);
+  bool ok = true;
+  for (int i = 0; i < batch->count; ++i)
+  {
+    BatchItem *item = &batch->items[i];
+    mutex_lock(&batch->lock);
+    while (!item->done)
+      cond_wait(&batch->ready, &batch->lock);
+    mutex_unlock(&batch->lock);
+    fwrite(item->err.data, 1, item->err.count, err);
+    fwrite(item->out.data, 1, item->out.count, out);
+    free(item->err.data);
+    free(item->out.data);
+    ok = ok && !item->failed;
+  }
+  fflush(out);
+  fflush(err);
+  for (int i = 0; i < count; ++i)
+    thread_join(threads[i]);
+  free(threads);
+  return ok;
+}
@@ -0,0 +1,51 @@
+//
+// batch.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "context.h"
+#include "thread.h"
+
+#define BATCH_MIN_CAPACITY (1 << 4)
+#define BATCH_MAX_SYMBOLS  (1 << 20)
+
+typedef struct
+{
+  char   *file;
+  bool   done;
+  bool   failed;
+  Buffer out;
+  Buffer err;
+} BatchItem;
+
+// Files are compiled on a pool of workers, each with a context of its own
+// that it reuses from one file to the next, resetting it once it holds
+// BATCH_MAX_SYMBOLS symbols. Output is kept per file and
+// written in the order the files were added, as soon as each one is done.
+typedef struct
+{
+  int            flags;
+  bool           flat;
+  AstPrintFormat format;
+  Mutex          lock;
+  Cond           ready;
+  int            capacity;
+  int            count;
+  BatchItem      *items;
+  int            next;
+} Batch;
+
+void batch_init(Batch *batch, int flags, bool flat, AstPrintFormat format);
+void batch_deinit(Batch *batch);
+void batch_add(Batch *batch, char *file);
+bool batch_run(Batch *batch, int threadCount, FILE *out, FILE *err);
+
+#endif // BATCH_H
@@ -9,6 +9,8 @@
 //
 
 #include "buffer.h"
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -49,3 +51,17 @@ void buffer_write(Buffer *buf, size_t count, void *ptr)
   memcpy(&buf->data[buf->count], ptr, count);
   buf->count += count;
 }
+
+void buffer_format(Buffer *buf, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+  // vsnprintf also writes the terminating NUL, which is not counted.
+  buffer_ensure_capacity(buf, buf->count + (size_t) length + 1);
+  va_start(args, fmt);
+  vsnprintf(&buf->data[buf->count], (size_t) length + 1, fmt, args);
+  va_end(args);
+  buf->count += (size_t) length;
+}
@@ -33,5 +33,6 @@ void buffer_init(Buffer *buf);
 void buffer_init_with_capacity(Buffer *buf, size_t capacity);
 void buffer_ensure_capacity(Buffer *buf, size_t capacity);
 void buffer_write(Buffer *buf, size_t count, void *ptr);
+void buffer_format(Buffer *buf, const char *fmt, ...);
 
 #endif // BUFFER_H
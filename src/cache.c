@@ -0,0 +1,305 @@
+//
+// cache.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define CACHE_MMAP
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef _WIN32
+  #include <io.h>
+#endif
+
+static inline size_t blob_size(CacheHeader *header);
+#ifdef CACHE_MMAP
+static inline bool map_file(AstCache *cache, const char *file);
+#endif
+static inline bool read_file(AstCache *cache, const char *file);
+static inline bool check_flat(AstFlat *flat, size_t length);
+static inline bool write_array(FILE *fp, void *ptr, size_t size, size_t count);
+static inline FILE *open_temp(char *path);
+static inline bool sync_file(FILE *fp);
+
+static inline size_t blob_size(CacheHeader *header)
+{
+  size_t size = sizeof(*header);
+  size += (sizeof(Token) + sizeof(TokenValue)) * header->tokenCount;
+  size += sizeof(uint32_t) * 3 * header->nodeCount;
+  size += sizeof(uint32_t) * header->extraCount;
+  size += sizeof(uint8_t) * header->nodeCount;
+  return size;
+}
+
+#ifdef CACHE_MMAP
+static inline bool map_file(AstCache *cache, const char *file)
+{
+  int fd = open(file, O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || !st.st_size)
+  {
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t) st.st_size;
+  char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  cache->data = data;
+  cache->size = size;
+  cache->mapped = true;
+  return true;
+}
+#endif
+
+static inline bool read_file(AstCache *cache, const char *file)
+{
+  FILE *fp = NULL;
+#ifdef _WIN32
+  fopen_s(&fp, file, "rb");
+#else
+  fp = fopen(file, "rb");
+#endif
+  if (!fp)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  size_t size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char *data = malloc(size ? size : 1);
+  size_t count = fread(data, 1, size, fp);
+  fclose(fp);
+  if (count != size)
+  {
+    free(data);
+    return false;
+  }
+  cache->data = data;
+  cache->size = size;
+  cache->mapped = false;
+  return true;
+}
+
+static inline bool check_flat(AstFlat *flat, size_t length)
+{
+  // A damaged or foreign file must not send the printer out of bounds or
+  // around a cycle, so children have to come after their parent.
+  for (int i = 0; i < flat->tokenCount; ++i)
+  {
+    Token *token = &flat->tokens[i];
+    if ((uint64_t) token->offset + token->length > length)
+      return false;
+  }
+  uint32_t nodeCount = (uint32_t) flat->count;
+  uint32_t extraCount = (uint32_t) flat->extraCount;
+  for (uint32_t i = 0; i < nodeCount; ++i)
+  {
+    if (flat->kinds[i] >= AST_NODE_KIND_COUNT)
+      return false;
+    if (ast_node_is_leaf((AstNodeKind) flat->kinds[i]))
+    {
+      if (flat->mainTokens[i] >= (uint32_t) flat->tokenCount)
+        return false;
+      continue;
+    }
+    uint32_t start = flat->childStarts[i];
+    uint32_t count = flat->childCounts[i];
+    if ((uint64_t) start + count > extraCount)
+      return false;
+    for (uint32_t j = start; j < start + count; ++j)
+    {
+      uint32_t child = flat->extra[j];
+      if (child != AST_FLAT_NONE && (child <= i || child >= nodeCount))
+        return false;
+    }
+  }
+  return true;
+}
+
+static inline bool write_array(FILE *fp, void *ptr, size_t size, size_t count)
+{
+  return !count || fwrite(ptr, size, count, fp) == count;
+}
+
+static inline FILE *open_temp(char *path)
+{
+  // Replaces the trailing XXXXXX of the path with a name no other writer
+  // holds.
+  FILE *fp = NULL;
+#ifdef _WIN32
+  if (_mktemp_s(path, strlen(path) + 1))
+    return NULL;
+  fopen_s(&fp, path, "wbx");
+#else
+  int fd = mkstemp(path);
+  if (fd == -1)
+    return NULL;
+  // The file is renamed into place, so it gets the mode fopen would give.
+  mode_t mask = umask(0);
+  umask(mask);
+  fchmod(fd, 0666 & ~mask);
+  fp = fdopen(fd, "wb");
+  if (!fp)
+  {
+    close(fd);
+    remove(path);
+  }
+#endif
+  return fp;
+}
+
+static inline bool sync_file(FILE *fp)
+{
+  if (fflush(fp))
+    return false;
+#ifdef _WIN32
+  return !_commit(_fileno(fp));
+#else
+  return !fsync(fileno(fp));
+#endif
+}
+
+uint64_t cache_hash(const char *chars, size_t length)
+{
+  // FNV-1a, 64-bit.
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; ++i)
+  {
+    hash ^= (uint8_t) chars[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool cache_load(AstCache *cache, const char *file, uint64_t hash,
+  size_t length)
+{
+  bool loaded = false;
+#ifdef CACHE_MMAP
+  loaded = map_file(cache, file);
+#endif
+  if (!loaded && !read_file(cache, file))
+    return false;
+  CacheHeader *header = (CacheHeader *) cache->data;
+  if (cache->size < sizeof(*header)
+    || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic))
+    || header->hash != hash
+    || cache->size != blob_size(header)
+    || !header->nodeCount)
+  {
+    cache_unload(cache);
+    return false;
+  }
+  // The flat AST points straight into the file.
+  char *data = &cache->data[sizeof(*header)];
+  AstFlat *flat = &cache->flat;
+  int nodeCount = (int) header->nodeCount;
+  int extraCount = (int) header->extraCount;
+  int tokenCount = (int) header->tokenCount;
+  flat->tokens = (Token *) data;
+  data += sizeof(*flat->tokens) * tokenCount;
+  flat->values = (TokenValue *) data;
+  data += sizeof(*flat->values) * tokenCount;
+  flat->mainTokens = (uint32_t *) data;
+  data += sizeof(*flat->mainTokens) * nodeCount;
+  flat->childStarts = (uint32_t *) data;
+  data += sizeof(*flat->childStarts) * nodeCount;
+  flat->childCounts = (uint32_t *) data;
+  data += sizeof(*flat->childCounts) * nodeCount;
+  flat->extra = (uint32_t *) data;
+  data += sizeof(*flat->extra) * extraCount;
+  flat->kinds = (uint8_t *) data;
+  flat->capacity = nodeCount;
+  flat->count = nodeCount;
+  flat->extraCapacity = extraCount;
+  flat->extraCount = extraCount;
+  flat->tokenCapacity = tokenCount;
+  flat->tokenCount = tokenCount;
+  if (!check_flat(flat, length))
+  {
+    cache_unload(cache);
+    return false;
+  }
+  return true;
+}
+
+void cache_unload(AstCache *cache)
+{
+#ifdef CACHE_MMAP
+  if (cache->mapped)
+  {
+    munmap(cache->data, cache->size);
+    return;
+  }
+#endif
+  free(cache->data);
+}
+
+bool cache_store(const char *file, uint64_t hash, AstFlat *flat)
+{
+  // Every writer fills a temporary file of its own in the same directory
+  // and renames it over the cache file, so readers only see whole files.
+  size_t length = strlen(file);
+  char *tmpFile = malloc(length + 8);
+  memcpy(tmpFile, file, length);
+  memcpy(&tmpFile[length], ".XXXXXX", 8);
+  FILE *fp = open_temp(tmpFile);
+  if (!fp)
+  {
+    free(tmpFile);
+    return false;
+  }
+  CacheHeader header = {
+    .hash = hash,
+    .nodeCount = (uint32_t) flat->count,
+    .extraCount = (uint32_t) flat->extraCount,
+    .tokenCount = (uint32_t) flat->tokenCount
+  };
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  int tokenCount = flat->tokenCount;
+  TokenValue *values = malloc(sizeof(*values) * (tokenCount ? tokenCount : 1));
+  memcpy(values, flat->values, sizeof(*values) * tokenCount);
+  for (int i = 0; i < flat->count; ++i)
+  {
+    AstNodeKind kind = (AstNodeKind) flat->kinds[i];
+    if (kind == AST_NODE_KIND_IDENT || kind == AST_NODE_KIND_STRING)
+      values[flat->mainTokens[i]] = (TokenValue) { 0 };
+  }
+  int nodeCount = flat->count;
+  bool ok = write_array(fp, &header, sizeof(header), 1)
+    && write_array(fp, flat->tokens, sizeof(*flat->tokens), tokenCount)
+    && write_array(fp, values, sizeof(*values), tokenCount)
+    && write_array(fp, flat->mainTokens, sizeof(*flat->mainTokens), nodeCount)
+    && write_array(fp, flat->childStarts, sizeof(*flat->childStarts), nodeCount)
+    && write_array(fp, flat->childCounts, sizeof(*flat->childCounts), nodeCount)
+    && write_array(fp, flat->extra, sizeof(*flat->extra), flat->extraCount)
+    && write_array(fp, flat->kinds, sizeof(*flat->kinds), nodeCount)
+    && sync_file(fp);
+  free(values);
+  ok = !fclose(fp) && ok;
+#ifdef _WIN32
+  if (ok)
+    remove(file);
+#endif
+  ok = ok && !rename(tmpFile, file);
+  if (!ok)
+    remove(tmpFile);
+  free(tmpFile);
+  return ok;
+}
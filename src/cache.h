@@ -0,0 +1,50 @@
+//
+// cache.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+#define CACHE_MAGIC "PWCAST1"
+
+// A cache file is a header followed by the arrays of a flat AST, ordered
+// by alignment, so that a mapped file is used as is. Files are keyed by
+// the hash of the source and are only meant for the machine that wrote
+// them. Symbol values are cleared, since symbol IDs belong to the
+// interner of the process that wrote the file.
+typedef struct
+{
+  char     magic[8];
+  uint64_t hash;
+  uint32_t nodeCount;
+  uint32_t extraCount;
+  uint32_t tokenCount;
+  uint32_t reserved;
+} CacheHeader;
+
+typedef struct
+{
+  AstFlat flat;
+  char    *data;
+  size_t  size;
+  bool    mapped;
+} AstCache;
+
+uint64_t cache_hash(const char *chars, size_t length);
+bool cache_load(AstCache *cache, const char *file, uint64_t hash,
+  size_t length);
+void cache_unload(AstCache *cache);
+bool cache_store(const char *file, uint64_t hash, AstFlat *flat);
+
+#endif // CACHE_H
@@ -8,72 +8,527 @@
 // located in the root directory of this project.
 //
 
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "buffer.h"
-#include "parser.h"
+#include "batch.h"
+#include "cache.h"
+#include "context.h"
+#include "module.h"
+#include "server.h"
+
+#define INPUT_LIST_MIN_CAPACITY (1 << 4)
+
+#define MAX_THREAD_COUNT 1024
+
+typedef struct
+{
+  int  capacity;
+  int  count;
+  char **files;
+} InputList;
 
 static inline void print_usage(char *cmd);
-static inline void load_file(Buffer *buf, char *file);
-static inline FILE *open_file(char *file);
-static inline size_t file_size(FILE *fp);
+static size_t read_stream(void *data, char *chars, size_t size);
+static inline bool parse_format(const char *name, AstPrintFormat *format);
+static inline bool parse_thread_count(const char *arg, int *threadCount);
+static inline void print_ast(AstNode *ast, const char *text, bool flat,
+  AstPrintFormat format);
+static void print_diag(const Diagnostic *diag, void *data);
+static inline int compile(Context *ctx, ContextStatus status, char *file,
+  bool flat, AstPrintFormat format);
+static inline int compile_cached(Context *ctx, char *file,
+  const char *cacheDir, AstPrintFormat format);
+static inline int compile_modules(char **files, int fileCount, int flags,
+  bool flat, AstPrintFormat format, int threadCount);
+static inline void input_list_init(InputList *inputs);
+static inline void input_list_deinit(InputList *inputs);
+static inline void input_list_add(InputList *inputs, const char *file);
+static inline bool input_list_read(InputList *inputs, const char *listFile);
+static inline bool collect_inputs(InputList *inputs, char **args,
+  int argCount);
+static inline int compile_inputs(char **args, int argCount, int flags,
+  bool flat, AstPrintFormat format, bool modules, int threadCount);
+static inline int compile_remote(const char *socketPath, char **args,
+  int argCount, int flags, bool flat, AstPrintFormat format, bool modules);
 
 static inline void print_usage(char *cmd)
 {
-  printf("\nUsage: %s <input-file>\n", cmd);
+  printf("\nUsage: %s [options] <input-file>...\n", cmd);
+  printf("\nUse - as input file to read from standard input, and @<file> to read\n");
+  printf("input files from a list, one per line.\n");
+  printf("\nOptions:\n");
+  printf("  -t        tokenize the whole input before parsing\n");
+  printf("  -f        print the AST from its flat encoding\n");
+  printf("  -d        parse declarations only, leaving function bodies unparsed\n");
+  printf("  -c <dir>  reuse and store flat ASTs in a cache directory\n");
+  printf("  -p <fmt>  print the AST as text (default) or json\n");
+  printf("  -m        also parse the modules the input imports\n");
+  printf("  -j <n>    parse on n threads, up to 1024 (default: one per CPU)\n");
+  printf("  --server <socket>   keep parsed modules in memory and serve compile\n");
+  printf("                      requests on a Unix socket, until interrupted\n");
+  printf("  --connect <socket>  send the compile request to a server\n");
+}
+
+static size_t read_stream(void *data, char *chars, size_t size)
+{
+  return fread(chars, 1, size, (FILE *) data);
+}
+
+static inline bool parse_format(const char *name, AstPrintFormat *format)
+{
+  if (!strcmp(name, "text"))
+  {
+    *format = AST_PRINT_FORMAT_TEXT;
+    return true;
+  }
+  if (!strcmp(name, "json"))
+  {
+    *format = AST_PRINT_FORMAT_JSON;
+    return true;
+  }
+  return false;
+}
+
+static inline bool parse_thread_count(const char *arg, int *threadCount)
+{
+  if (arg[0] < '0' || arg[0] > '9')
+    return false;
+  char *end;
+  long count = strtol(arg, &end, 10);
+  if (*end || count < 1 || count > MAX_THREAD_COUNT)
+    return false;
+  *threadCount = (int) count;
+  return true;
 }
 
-static inline void load_file(Buffer *buf, char *file)
+static inline void print_ast(AstNode *ast, const char *text, bool flat,
+  AstPrintFormat format)
 {
-  FILE *fp = open_file(file);
-  size_t size = file_size(fp);
-  size_t count = size + 1;
-  buffer_init_with_capacity(buf, count);
-  buf->count = count;
-  memset(buf->data, 0, count);
-  fread(buf->data, 1, size, fp);
-  fclose(fp);
+  if (!flat)
+  {
+    ast_print(ast, text, format, stdout);
+    return;
+  }
+  AstFlat flatAst;
+  ast_flat_init(&flatAst);
+  ast_flatten(&flatAst, ast);
+  ast_flat_print(&flatAst, text, format, stdout);
+  ast_flat_deinit(&flatAst);
 }
 
-static inline FILE *open_file(char *file)
+static void print_diag(const Diagnostic *diag, void *data)
 {
-  FILE *fp = NULL;
-#ifdef _WIN32
-  fopen_s(&fp, file, "r");
-#else
-  fp = fopen(file, "r");
-#endif
-  if (!fp)
+  diag_write(diag, (FILE *) data);
+}
+
+static inline int compile(Context *ctx, ContextStatus status, char *file,
+  bool flat, AstPrintFormat format)
+{
+  if (status == CONTEXT_STATUS_IO_ERROR)
   {
     fprintf(stderr, "\nERROR: cannot open file %s\n", file);
-    exit(EXIT_FAILURE);
+    return EXIT_FAILURE;
+  }
+  if (status != CONTEXT_STATUS_OK)
+    return EXIT_FAILURE;
+  print_ast(ctx->ast, context_text(ctx), flat, format);
+  return EXIT_SUCCESS;
+}
+
+static inline int compile_cached(Context *ctx, char *file,
+  const char *cacheDir, AstPrintFormat format)
+{
+  Source src;
+  if (!source_load(&src, file))
+  {
+    fprintf(stderr, "\nERROR: cannot open file %s\n", file);
+    return EXIT_FAILURE;
+  }
+  uint64_t hash = cache_hash(src.chars, src.length);
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%016" PRIx64 ".ast", cacheDir, hash);
+  AstCache cache;
+  if (cache_load(&cache, path, hash, src.length))
+  {
+    ast_flat_print(&cache.flat, src.chars, format, stdout);
+    cache_unload(&cache);
+    source_unload(&src);
+    return EXIT_SUCCESS;
+  }
+  ContextStatus status = context_parse_string(ctx, file, src.chars, src.length);
+  source_unload(&src);
+  if (status != CONTEXT_STATUS_OK)
+    return EXIT_FAILURE;
+  AstFlat flat;
+  ast_flat_init(&flat);
+  ast_flatten(&flat, ctx->ast);
+  if (!cache_store(path, hash, &flat))
+    fprintf(stderr, "WARNING: cannot write cache file %s\n", path);
+  ast_flat_print(&flat, context_text(ctx), format, stdout);
+  ast_flat_deinit(&flat);
+  return EXIT_SUCCESS;
+}
+
+static inline int compile_modules(char **files, int fileCount, int flags,
+  bool flat, AstPrintFormat format, int threadCount)
+{
+  // Modules imported by several inputs are parsed only once.
+  ModuleGraph graph;
+  module_graph_init(&graph, flags);
+  int *roots = malloc(sizeof(*roots) * fileCount);
+  for (int i = 0; i < fileCount; ++i)
+  {
+    roots[i] = module_graph_add_root(&graph, files[i]);
+    if (roots[i] == -1)
+    {
+      fprintf(stderr, "\nERROR: cannot open file %s\n", files[i]);
+      free(roots);
+      module_graph_deinit(&graph);
+      return EXIT_FAILURE;
+    }
+  }
+  module_graph_parse(&graph, threadCount);
+  // Modules are reported in dependency order, whatever order the workers
+  // happened to finish in.
+  int *order = malloc(sizeof(*order) * graph.count);
+  int count = module_graph_order(&graph, fileCount, roots, order);
+  free(roots);
+  bool failed = false;
+  for (int i = 0; i < count; ++i)
+  {
+    Module *module = graph.modules[order[i]];
+    if (!module->ast)
+      continue;
+    DiagList *diags = &module->parser.diags;
+    diag_print(diags, stderr);
+    failed = failed || diags->count;
+  }
+  if (!failed)
+    for (int i = 0; i < count; ++i)
+    {
+      Module *module = graph.modules[order[i]];
+      if (module->ast)
+        print_ast(module->ast, lexer_text(&module->parser.lex), flat, format);
+    }
+  free(order);
+  module_graph_deinit(&graph);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static inline void input_list_init(InputList *inputs)
+{
+  int capacity = INPUT_LIST_MIN_CAPACITY;
+  inputs->capacity = capacity;
+  inputs->count = 0;
+  inputs->files = malloc(sizeof(*inputs->files) * capacity);
+}
+
+static inline void input_list_deinit(InputList *inputs)
+{
+  for (int i = 0; i < inputs->count; ++i)
+    free(inputs->files[i]);
+  free(inputs->files);
+}
+
+static inline void input_list_add(InputList *inputs, const char *file)
+{
+  if (inputs->count == inputs->capacity)
+  {
+    int capacity = inputs->capacity << 1;
+    inputs->files = realloc(inputs->files, sizeof(*inputs->files) * capacity);
+    inputs->capacity = capacity;
+  }
+  size_t size = strlen(file) + 1;
+  char *copy = malloc(size);
+  memcpy(copy, file, size);
+  inputs->files[inputs->count++] = copy;
+}
+
+static inline bool input_list_read(InputList *inputs, const char *listFile)
+{
+  // One file per line; blank lines and trailing spaces are ignored.
+  FILE *stream = fopen(listFile, "r");
+  if (!stream)
+    return false;
+  char line[4096];
+  while (fgets(line, sizeof(line), stream))
+  {
+    size_t length = strlen(line);
+    while (length && (line[length - 1] == '\n' || line[length - 1] == '\r'
+      || line[length - 1] == ' ' || line[length - 1] == '\t'))
+      --length;
+    line[length] = '\0';
+    if (length)
+      input_list_add(inputs, line);
+  }
+  fclose(stream);
+  return true;
+}
+
+static inline bool collect_inputs(InputList *inputs, char **args,
+  int argCount)
+{
+  for (int i = 0; i < argCount; ++i)
+  {
+    char *arg = args[i];
+    if (!strcmp(arg, "-"))
+    {
+      fprintf(stderr, "\nERROR: standard input cannot be used with other input files\n");
+      return false;
+    }
+    if (arg[0] != '@')
+    {
+      input_list_add(inputs, arg);
+      continue;
+    }
+    if (!input_list_read(inputs, &arg[1]))
+    {
+      fprintf(stderr, "\nERROR: cannot open file list %s\n", &arg[1]);
+      return false;
+    }
   }
-  return fp;
+  return true;
 }
 
-static inline size_t file_size(FILE *fp)
+static inline int compile_inputs(char **args, int argCount, int flags,
+  bool flat, AstPrintFormat format, bool modules, int threadCount)
 {
-  fseek(fp, 0, SEEK_END);
-  size_t size = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
-  return size;
+  InputList inputs;
+  input_list_init(&inputs);
+  if (!collect_inputs(&inputs, args, argCount))
+  {
+    input_list_deinit(&inputs);
+    return EXIT_FAILURE;
+  }
+  if (!threadCount)
+    threadCount = thread_cpu_count();
+  int result;
+  if (modules)
+    result = compile_modules(inputs.files, inputs.count, flags, flat, format,
+      threadCount);
+  else
+  {
+    Batch batch;
+    batch_init(&batch, flags, flat, format);
+    for (int i = 0; i < inputs.count; ++i)
+      batch_add(&batch, inputs.files[i]);
+    bool ok = batch_run(&batch, threadCount, stdout, stderr);
+    batch_deinit(&batch);
+    result = ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  input_list_deinit(&inputs);
+  return result;
+}
+
+static inline int compile_remote(const char *socketPath, char **args,
+  int argCount, int flags, bool flat, AstPrintFormat format, bool modules)
+{
+  // The server reads the inputs itself, so it cannot see this process's
+  // standard input.
+  for (int i = 0; i < argCount; ++i)
+  {
+    if (!strcmp(args[i], "-"))
+    {
+      fprintf(stderr, "\nERROR: standard input is not supported with --connect\n");
+      return EXIT_FAILURE;
+    }
+  }
+  InputList inputs;
+  input_list_init(&inputs);
+  if (!collect_inputs(&inputs, args, argCount))
+  {
+    input_list_deinit(&inputs);
+    return EXIT_FAILURE;
+  }
+  ServerRequest req = {
+    .flags = flags,
+    .format = (int32_t) format,
+    .flat = flat,
+    .modules = modules,
+    .fileCount = inputs.count
+  };
+  int result;
+  if (!server_send(socketPath, &req, inputs.files, stdout, stderr, &result))
+  {
+    fprintf(stderr, "\nERROR: cannot connect to server %s\n", socketPath);
+    result = EXIT_FAILURE;
+  }
+  input_list_deinit(&inputs);
+  return result;
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc < 2)
+  int flags = 0;
+  bool flat = false;
+  char *cacheDir = NULL;
+  bool modules = false;
+  int threadCount = 0;
+  char *serverPath = NULL;
+  char *connectPath = NULL;
+  AstPrintFormat format = AST_PRINT_FORMAT_TEXT;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-' && argv[i][1]; ++i)
+  {
+    if (!strcmp(argv[i], "-t"))
+    {
+      flags |= PARSER_FLAG_PRETOKENIZE;
+      continue;
+    }
+    if (!strcmp(argv[i], "-d"))
+    {
+      flags |= PARSER_FLAG_LAZY_BODIES;
+      continue;
+    }
+    if (!strcmp(argv[i], "-f"))
+    {
+      flat = true;
+      continue;
+    }
+    if (!strcmp(argv[i], "-c") && i + 1 < argc)
+    {
+      cacheDir = argv[++i];
+      continue;
+    }
+    if (!strcmp(argv[i], "-m"))
+    {
+      modules = true;
+      continue;
+    }
+    if (!strcmp(argv[i], "-j") && i + 1 < argc)
+    {
+      if (!parse_thread_count(argv[++i], &threadCount))
+      {
+        fprintf(stderr, "\nERROR: invalid thread count %s\n", argv[i]);
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+    {
+      if (!parse_format(argv[++i], &format))
+      {
+        fprintf(stderr, "\nERROR: unknown format %s\n", argv[i]);
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    if (!strcmp(argv[i], "--server") && i + 1 < argc)
+    {
+      serverPath = argv[++i];
+      continue;
+    }
+    if (!strcmp(argv[i], "--connect") && i + 1 < argc)
+    {
+      connectPath = argv[++i];
+      continue;
+    }
+    fprintf(stderr, "\nERROR: unknown option %s\n", argv[i]);
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (serverPath)
+  {
+    if (i < argc || connectPath || cacheDir)
+    {
+      fprintf(stderr, "\nERROR: option --server takes no input file or -c and --connect options\n");
+      return EXIT_FAILURE;
+    }
+    if (!threadCount)
+      threadCount = thread_cpu_count();
+    if (!server_run(serverPath, threadCount))
+    {
+      fprintf(stderr, "\nERROR: cannot listen on %s\n", serverPath);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+  if (i == argc)
   {
     fprintf(stderr, "\nERROR: no input file\n");
     print_usage(argv[0]);
     return EXIT_FAILURE;
   }
-  char *file = argv[1];
-  Buffer buf;
-  load_file(&buf, argv[1]);
-  Parser parser;
-  parser_init(&parser, file, buf.data);
-  AstNode *ast = parser_parse(&parser);
-  ast_print(ast);
-  return EXIT_SUCCESS;
+  if (connectPath)
+  {
+    if (cacheDir)
+    {
+      fprintf(stderr, "\nERROR: options -c and --connect cannot be used together\n");
+      return EXIT_FAILURE;
+    }
+    return compile_remote(connectPath, &argv[i], argc - i, flags, flat, format,
+      modules);
+  }
+  if (i + 1 < argc || argv[i][0] == '@')
+  {
+    if (cacheDir)
+    {
+      fprintf(stderr, "\nERROR: option -c cannot be used with several input files\n");
+      return EXIT_FAILURE;
+    }
+    return compile_inputs(&argv[i], argc - i, flags, flat, format, modules,
+      threadCount);
+  }
+  char *file = argv[i];
+  bool isStdin = !strcmp(file, "-");
+  if (isStdin)
+  {
+    if (flags & PARSER_FLAG_PRETOKENIZE)
+    {
+      fprintf(stderr, "\nERROR: option -t cannot be used with standard input\n");
+      return EXIT_FAILURE;
+    }
+    if (flags & PARSER_FLAG_LAZY_BODIES)
+    {
+      fprintf(stderr, "\nERROR: option -d cannot be used with standard input\n");
+      return EXIT_FAILURE;
+    }
+    if (cacheDir)
+    {
+      fprintf(stderr, "\nERROR: option -c cannot be used with standard input\n");
+      return EXIT_FAILURE;
+    }
+    if (modules)
+    {
+      fprintf(stderr, "\nERROR: option -m cannot be used with standard input\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if (cacheDir && modules)
+  {
+    fprintf(stderr, "\nERROR: options -c and -m cannot be used together\n");
+    return EXIT_FAILURE;
+  }
+  if (cacheDir && (flags & PARSER_FLAG_LAZY_BODIES))
+  {
+    fprintf(stderr, "\nERROR: options -c and -d cannot be used together\n");
+    return EXIT_FAILURE;
+  }
+  if (modules)
+  {
+    if (!threadCount)
+      threadCount = thread_cpu_count();
+    return compile_modules(&file, 1, flags, flat, format, threadCount);
+  }
+  Context ctx;
+  context_init(&ctx, flags);
+  context_set_sink(&ctx, print_diag, stderr);
+  int result;
+  if (isStdin)
+  {
+    ContextStatus status = context_parse_reader(&ctx, "<stdin>", read_stream,
+      stdin);
+    result = compile(&ctx, status, file, flat, format);
+  }
+  else if (cacheDir)
+    result = compile_cached(&ctx, file, cacheDir, format);
+  else
+    result = compile(&ctx, context_parse_file(&ctx, file), file, flat, format);
+  context_deinit(&ctx);
+  return result;
 }
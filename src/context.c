@@ -0,0 +1,130 @@
+//
+// context.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "context.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline void release(Context *ctx);
+static inline ContextStatus finish(Context *ctx);
+
+static inline void release(Context *ctx)
+{
+  if (ctx->parsed)
+    parser_deinit(&ctx->parser);
+  if (ctx->loaded)
+    source_unload(&ctx->src);
+  ctx->loaded = false;
+  ctx->parsed = false;
+  ctx->ast = NULL;
+}
+
+static inline ContextStatus finish(Context *ctx)
+{
+  ctx->parsed = true;
+  ctx->ast = parser_parse(&ctx->parser);
+  DiagList *diags = &ctx->parser.diags;
+  if (ctx->sink)
+    for (int i = 0; i < diags->count; ++i)
+      ctx->sink(&diags->items[i], ctx->sinkData);
+  return diags->count ? CONTEXT_STATUS_SYNTAX_ERROR : CONTEXT_STATUS_OK;
+}
+
+const char *context_status_name(ContextStatus status)
+{
+  char *name = NULL;
+  switch (status)
+  {
+  case CONTEXT_STATUS_OK:           name = "ok";           break;
+  case CONTEXT_STATUS_IO_ERROR:     name = "I/O error";    break;
+  case CONTEXT_STATUS_SYNTAX_ERROR: name = "syntax error"; break;
+  }
+  return name;
+}
+
+void context_init(Context *ctx, int flags)
+{
+  ctx->flags = flags;
+  ctx->sink = NULL;
+  ctx->sinkData = NULL;
+  interner_init(&ctx->interner);
+  ctx->loaded = false;
+  ctx->parsed = false;
+  ctx->ast = NULL;
+}
+
+void context_deinit(Context *ctx)
+{
+  release(ctx);
+  interner_deinit(&ctx->interner);
+}
+
+void context_reset(Context *ctx)
+{
+  // Symbol ids start over, so nothing from earlier units may be kept.
+  release(ctx);
+  interner_deinit(&ctx->interner);
+  interner_init(&ctx->interner);
+}
+
+void context_set_sink(Context *ctx, DiagSink sink, void *data)
+{
+  ctx->sink = sink;
+  ctx->sinkData = data;
+}
+
+ContextStatus context_parse_file(Context *ctx, char *file)
+{
+  release(ctx);
+  if (!source_load(&ctx->src, file))
+    return CONTEXT_STATUS_IO_ERROR;
+  ctx->loaded = true;
+  parser_init(&ctx->parser, file, ctx->src.chars, &ctx->interner, ctx->flags);
+  return finish(ctx);
+}
+
+ContextStatus context_parse_string(Context *ctx, char *name,
+  const char *chars, size_t length)
+{
+  // The lexer reads past the end of its input, so the string is copied
+  // into a padded buffer.
+  release(ctx);
+  size_t size = length + LEXER_PADDING;
+  char *copy = calloc(size, 1);
+  memcpy(copy, chars, length);
+  ctx->src = (Source) {
+    .chars = copy,
+    .length = length,
+    .size = size,
+    .mapped = false
+  };
+  ctx->loaded = true;
+  parser_init(&ctx->parser, name, copy, &ctx->interner, ctx->flags);
+  return finish(ctx);
+}
+
+ContextStatus context_parse_reader(Context *ctx, char *name, LexerRead read,
+  void *data)
+{
+  // The input is consumed as it is read, so the flags do not apply.
+  release(ctx);
+  parser_init_reader(&ctx->parser, name, read, data, &ctx->interner);
+  return finish(ctx);
+}
+
+DiagList *context_diags(Context *ctx)
+{
+  return ctx->parsed ? &ctx->parser.diags : NULL;
+}
+
+char *context_text(Context *ctx)
+{
+  return ctx->parsed ? lexer_text(&ctx->parser.lex) : NULL;
+}
@@ -0,0 +1,59 @@
+//
+// context.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stddef.h>
+#include "parser.h"
+#include "source.h"
+
+typedef enum
+{
+  CONTEXT_STATUS_OK,
+  CONTEXT_STATUS_IO_ERROR,
+  CONTEXT_STATUS_SYNTAX_ERROR
+} ContextStatus;
+
+// A context parses one unit at a time and holds it until the next parse:
+// the tree, the text its tokens point into and its diagnostics. Symbols are
+// interned in the context, so they keep their ids from one unit to the
+// next, and the interner grows with every new symbol until the context is
+// reset or deinitialized. A long-lived context should be reset from time
+// to time. Nothing is shared between contexts, and nothing is ever printed
+// or exits the process; diagnostics go to the sink, if any, once a unit is
+// parsed.
+typedef struct
+{
+  int      flags;
+  DiagSink sink;
+  void     *sinkData;
+  Interner interner;
+  bool     loaded;
+  Source   src;
+  bool     parsed;
+  Parser   parser;
+  AstNode  *ast;
+} Context;
+
+const char *context_status_name(ContextStatus status);
+void context_init(Context *ctx, int flags);
+void context_deinit(Context *ctx);
+void context_reset(Context *ctx);
+void context_set_sink(Context *ctx, DiagSink sink, void *data);
+ContextStatus context_parse_file(Context *ctx, char *file);
+ContextStatus context_parse_string(Context *ctx, char *name,
+  const char *chars, size_t length);
+ContextStatus context_parse_reader(Context *ctx, char *name, LexerRead read,
+  void *data);
+DiagList *context_diags(Context *ctx);
+char *context_text(Context *ctx);
+
+#endif // CONTEXT_H
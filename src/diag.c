@@ -0,0 +1,89 @@
+//
+// diag.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "diag.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIAG_FORMAT "\nERROR: %s\n--> %s:%d:%d\n"
+
+static inline bool precedes(Diagnostic *diag, int ln, int col);
+
+static inline bool precedes(Diagnostic *diag, int ln, int col)
+{
+  return diag->ln < ln || (diag->ln == ln && diag->col <= col);
+}
+
+void diag_init(DiagList *diags)
+{
+  int capacity = DIAG_MIN_CAPACITY;
+  arena_init(&diags->arena);
+  diags->capacity = capacity;
+  diags->count = 0;
+  diags->items = malloc(sizeof(*diags->items) * capacity);
+}
+
+void diag_deinit(DiagList *diags)
+{
+  arena_deinit(&diags->arena);
+  free(diags->items);
+}
+
+void diag_report(DiagList *diags, const char *file, int ln, int col,
+  const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+  char *message = arena_alloc(&diags->arena, (size_t) length + 1);
+  va_start(args, fmt);
+  vsnprintf(message, (size_t) length + 1, fmt, args);
+  va_end(args);
+  if (diags->count == diags->capacity)
+  {
+    int newCapacity = diags->capacity << 1;
+    diags->items = realloc(diags->items, sizeof(*diags->items) * newCapacity);
+    diags->capacity = newCapacity;
+  }
+  // Reports mostly arrive in order, so this rarely moves anything.
+  int index = diags->count;
+  while (index && !precedes(&diags->items[index - 1], ln, col))
+    --index;
+  memmove(&diags->items[index + 1], &diags->items[index],
+    sizeof(*diags->items) * (diags->count - index));
+  diags->items[index] = (Diagnostic) {
+    .file = file,
+    .ln = ln,
+    .col = col,
+    .message = message
+  };
+  ++diags->count;
+}
+
+void diag_write(const Diagnostic *diag, FILE *stream)
+{
+  fprintf(stream, DIAG_FORMAT, diag->message, diag->file, diag->ln,
+    diag->col);
+}
+
+void diag_write_buffer(const Diagnostic *diag, Buffer *buf)
+{
+  buffer_format(buf, DIAG_FORMAT, diag->message, diag->file, diag->ln,
+    diag->col);
+}
+
+void diag_print(DiagList *diags, FILE *stream)
+{
+  for (int i = 0; i < diags->count; ++i)
+    diag_write(&diags->items[i], stream);
+}
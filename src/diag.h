@@ -0,0 +1,49 @@
+//
+// diag.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdio.h>
+#include "arena.h"
+#include "buffer.h"
+
+#define DIAG_MIN_CAPACITY (1 << 3)
+
+typedef struct
+{
+  const char *file;
+  int        ln;
+  int        col;
+  char       *message;
+} Diagnostic;
+
+// Diagnostics are kept sorted by location, so that those from the lexer
+// and the parser interleave even when the whole input is tokenized first.
+typedef struct
+{
+  Arena      arena;
+  int        capacity;
+  int        count;
+  Diagnostic *items;
+} DiagList;
+
+// A sink receives the diagnostics of a list one at a time, in order.
+typedef void (*DiagSink)(const Diagnostic *diag, void *data);
+
+void diag_init(DiagList *diags);
+void diag_deinit(DiagList *diags);
+void diag_report(DiagList *diags, const char *file, int ln, int col,
+  const char *fmt, ...);
+void diag_write(const Diagnostic *diag, FILE *stream);
+void diag_write_buffer(const Diagnostic *diag, Buffer *buf);
+void diag_print(DiagList *diags, FILE *stream);
+
+#endif // DIAG_H
@@ -0,0 +1,101 @@
+//
+// interner.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "interner.h"
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint32_t hash_chars(const char *chars, int length);
+static inline void grow(Interner *interner);
+
+static inline uint32_t hash_chars(const char *chars, int length)
+{
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < length; ++i)
+  {
+    hash ^= (uint8_t) chars[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static inline void grow(Interner *interner)
+{
+  int capacity = interner->capacity << 1;
+  uint32_t mask = (uint32_t) capacity - 1;
+  uint32_t *slots = calloc(capacity, sizeof(*slots));
+  for (int i = 0; i < interner->count; ++i)
+  {
+    uint32_t index = interner->symbols[i].hash & mask;
+    while (slots[index])
+      index = (index + 1) & mask;
+    slots[index] = (uint32_t) i + 1;
+  }
+  free(interner->slots);
+  interner->capacity = capacity;
+  interner->slots = slots;
+  // Symbols never outnumber half of the slots.
+  interner->symbols = realloc(interner->symbols,
+    sizeof(*interner->symbols) * (capacity >> 1));
+}
+
+void interner_init(Interner *interner)
+{
+  int capacity = INTERNER_MIN_CAPACITY;
+  arena_init(&interner->arena);
+  interner->capacity = capacity;
+  interner->slots = calloc(capacity, sizeof(*interner->slots));
+  interner->count = 0;
+  interner->symbols = malloc(sizeof(*interner->symbols) * (capacity >> 1));
+}
+
+void interner_deinit(Interner *interner)
+{
+  arena_deinit(&interner->arena);
+  free(interner->slots);
+  free(interner->symbols);
+}
+
+uint32_t interner_intern(Interner *interner, const char *chars, int length)
+{
+  uint32_t hash = hash_chars(chars, length);
+  uint32_t mask = (uint32_t) interner->capacity - 1;
+  uint32_t index = hash & mask;
+  for (;;)
+  {
+    uint32_t slot = interner->slots[index];
+    if (!slot)
+      break;
+    Symbol *symbol = &interner->symbols[slot - 1];
+    if (symbol->hash == hash && symbol->length == length
+     && !memcmp(symbol->chars, chars, length))
+      return slot - 1;
+    index = (index + 1) & mask;
+  }
+  uint32_t id = (uint32_t) interner->count;
+  char *copy = arena_alloc(&interner->arena, length + 1);
+  memcpy(copy, chars, length);
+  copy[length] = '\0';
+  interner->symbols[id] = (Symbol) {
+    .hash = hash,
+    .length = length,
+    .chars = copy
+  };
+  interner->slots[index] = id + 1;
+  ++interner->count;
+  if (interner->count << 1 >= interner->capacity)
+    grow(interner);
+  return id;
+}
+
+Symbol *interner_symbol(Interner *interner, uint32_t id)
+{
+  return &interner->symbols[id];
+}
@@ -0,0 +1,40 @@
+//
+// interner.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stdint.h>
+#include "arena.h"
+
+#define INTERNER_MIN_CAPACITY (1 << 10)
+
+typedef struct
+{
+  uint32_t hash;
+  int      length;
+  char     *chars;
+} Symbol;
+
+typedef struct
+{
+  Arena    arena;
+  int      capacity;
+  uint32_t *slots;
+  int      count;
+  Symbol   *symbols;
+} Interner;
+
+void interner_init(Interner *interner);
+void interner_deinit(Interner *interner);
+uint32_t interner_intern(Interner *interner, const char *chars, int length);
+Symbol *interner_symbol(Interner *interner, uint32_t id);
+
+#endif // INTERNER_H
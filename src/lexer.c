@@ -20,211 +20,655 @@
 #define char_at(l, i) ((l)->curr[(i)])
 #define current(l)    char_at(l, 0)
 
-static inline bool skip_space(Lexer *lex);
+#define CHAR_SPACE (1 << 0)
+#define CHAR_DIGIT (1 << 1)
+#define CHAR_ALPHA (1 << 2)
+#define CHAR_IDENT (1 << 3)
+
+#define S CHAR_SPACE
+#define D (CHAR_DIGIT | CHAR_IDENT)
+#define A (CHAR_ALPHA | CHAR_IDENT)
+
+#define is_space(c) (charClass[(unsigned char) (c)] & CHAR_SPACE)
+#define is_digit(c) (charClass[(unsigned char) (c)] & CHAR_DIGIT)
+#define is_alpha(c) (charClass[(unsigned char) (c)] & CHAR_ALPHA)
+#define is_ident(c) (charClass[(unsigned char) (c)] & CHAR_IDENT)
+
+#define keyword(c, l, kw, k) \
+  do { \
+    if ((l) == (int) sizeof(kw) - 1 && !memcmp((c), (kw), (l))) \
+      return (k); \
+  } while (0)
+
+static const unsigned char charClass[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+  0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+  A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+  0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+  A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0
+};
+
+#undef S
+#undef D
+#undef A
+
+static const double powersOfTen[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline void init(Lexer *lex, char *file, char *source,
+  Interner *interner, DiagList *diags);
+static inline bool refill(Lexer *lex, const char *chars);
+static inline void count_lines(const char *chars, const char *end, int *ln,
+  int *col);
+static inline void skip_space(Lexer *lex);
 static inline bool skip_comment(Lexer *lex);
-static inline void next(Lexer *lex);
-static inline void next_chars(Lexer *lex, int length);
-static inline bool match(Lexer *lex, char c, TokenKind kind);
-static inline bool match_chars(Lexer *lex, const char *chars, TokenKind kind);
-static inline bool match_keyword(Lexer *lex, const char *kw, TokenKind kind);
+static inline void emit(Lexer *lex, TokenKind kind, int length);
 static inline bool match_number(Lexer *lex);
+static inline int64_t decode_int(Lexer *lex, int length);
+static inline double decode_float(const char *chars, int length);
 static inline bool match_char(Lexer *lex);
-static inline bool match_string(Lexer *lex);
-static inline bool match_ident(Lexer *lex);
-static inline Token token(Lexer *lex, TokenKind kind, int length, char *chars);
+static inline void match_string(Lexer *lex);
+static inline void match_ident(Lexer *lex);
+static inline TokenKind keyword_kind(const char *chars, int length);
+static inline bool match_token(Lexer *lex);
+static inline void keep_text(Lexer *lex);
+static inline void set_token(Lexer *lex, TokenKind kind, int length, char *chars);
 static inline void lexical_error(Lexer *lex, const char *fmt, ...);
+static inline void stream_ensure_capacity(TokenStream *stream, int capacity);
+static inline void stream_append(TokenStream *stream, Lexer *lex);
+static inline uint32_t stream_start(TokenStream *stream, int index);
+static inline int stream_search(TokenStream *stream, uint32_t start);
+static inline void index_lines(Lexer *lex);
 
-static inline bool skip_space(Lexer *lex)
+static inline void init(Lexer *lex, char *file, char *source,
+  Interner *interner, DiagList *diags)
 {
-  if (!isspace(current(lex)))
-    return false;
-  do
-    next(lex);
-  while (isspace(current(lex)));
-  return true;
+  lex->file = file;
+  lex->source = source;
+  lex->curr = source;
+  lex->start = source;
+  lex->interner = interner;
+  lex->lineCount = 0;
+  lex->lines = NULL;
+  lex->read = NULL;
+  lex->data = NULL;
+  lex->capacity = 0;
+  lex->limit = NULL;
+  lex->end = NULL;
+  lex->saved = '\0';
+  lex->eof = true;
+  lex->baseLn = 1;
+  lex->baseCol = 1;
+  lex->diags = diags;
+  scanner_init(&lex->scan, scanner_detect());
 }
 
-static inline bool skip_comment(Lexer *lex)
+static inline bool refill(Lexer *lex, const char *chars)
 {
-  if (current(lex) != '/')
+  // In reader mode the window always ends right after a newline, so only
+  // tokens that may span lines (strings, block comments and whitespace)
+  // can run into its end. Everything from the current token on is moved
+  // to the front of the window and more input is read behind it.
+  if (!lex->read || chars != lex->limit || (lex->eof && lex->limit == lex->end))
     return false;
-  if (char_at(lex, 1) == '/')
+  char *keep = lex->curr;
+  count_lines(lex->source, keep, &lex->baseLn, &lex->baseCol);
+  *lex->limit = lex->saved;
+  size_t count = (size_t) (lex->end - keep);
+  memmove(lex->source, keep, count);
+  char *end = &lex->source[count];
+  char *limit = NULL;
+  while (!limit)
   {
-    next_chars(lex, 2);
-    while (current(lex) != '\n')
-      next(lex);
-    return true;
+    size_t used = (size_t) (end - lex->source);
+    if (used == lex->capacity)
+    {
+      lex->capacity <<= 1;
+      lex->source = realloc(lex->source, lex->capacity + LEXER_PADDING);
+      end = &lex->source[used];
+    }
+    size_t n = lex->read(lex->data, end, lex->capacity - used);
+    if (!n)
+    {
+      lex->eof = true;
+      limit = end;
+      break;
+    }
+    char *chars = end;
+    end += n;
+    for (char *newline = end; newline > chars; --newline)
+      if (newline[-1] == '\n')
+      {
+        limit = newline;
+        break;
+      }
   }
-  if (char_at(lex, 1) != '*')
-    return false;
-  next_chars(lex, 2);
-  while (current(lex) != '*' || char_at(lex, 1) != '/')
-    next(lex);
-  next_chars(lex, 2);
+  lex->curr = lex->source;
+  lex->start = lex->source;
+  lex->end = end;
+  lex->limit = limit;
+  lex->saved = *limit;
+  *limit = '\0';
   return true;
 }
 
-static inline void next(Lexer *lex)
+static inline void count_lines(const char *chars, const char *end, int *ln,
+  int *col)
 {
-  if (current(lex) == '\n')
+  for (;;)
   {
-    ++lex->ln;
-    lex->col = 1;
-    ++lex->curr;
-    return;
+    const char *newline = memchr(chars, '\n', end - chars);
+    if (!newline)
+      break;
+    ++*ln;
+    *col = 1;
+    chars = &newline[1];
   }
-  ++lex->col;
-  ++lex->curr;
+  *col += (int) (end - chars);
 }
 
-static inline void next_chars(Lexer *lex, int length)
+static inline void skip_space(Lexer *lex)
 {
-  for (int i = 0; i < length; ++i)
-    next(lex);
+  if (is_space(current(lex)))
+    lex->curr = (char *) lex->scan.space(lex->curr);
 }
 
-static inline bool match(Lexer *lex, char c, TokenKind kind)
-{
-  if (current(lex) != c)
-    return false;
-  lex->token = token(lex, kind, 1, lex->curr);
-  next(lex);
-  return true;
-}
-
-static inline bool match_chars(Lexer *lex, const char *chars, TokenKind kind)
+static inline bool skip_comment(Lexer *lex)
 {
-  int length = (int) strlen(chars);
-  if (memcmp(lex->curr, chars, length))
+  if (char_at(lex, 1) == '/')
+  {
+    lex->curr = (char *) lex->scan.line(&lex->curr[2]);
+    return true;
+  }
+  if (char_at(lex, 1) != '*')
     return false;
-  lex->token = token(lex, kind, length, lex->curr);
-  next_chars(lex, length);
+  const char *end = lex->scan.comment(&lex->curr[2]);
+  while (*end == '\0')
+  {
+    lex->curr = (char *) end;
+    if (!refill(lex, end))
+    {
+      lexical_error(lex, "unclosed block comment");
+      return true;
+    }
+    end = lex->scan.comment(lex->curr);
+  }
+  lex->curr = (char *) &end[2];
   return true;
 }
 
-static inline bool match_keyword(Lexer *lex, const char *kw, TokenKind kind)
+static inline void emit(Lexer *lex, TokenKind kind, int length)
 {
-  int length = (int) strlen(kw);
-  if (strncmp(lex->curr, kw, length)
-   || isalnum(char_at(lex, length))
-   || char_at(lex, length) == '_')
-    return false;
-  lex->token = token(lex, kind, length, lex->curr);
-  next_chars(lex, length);
-  return true;
+  set_token(lex, kind, length, lex->curr);
+  lex->curr += length;
 }
 
 static inline bool match_number(Lexer *lex)
 {
-  int length = 0;
-  if (char_at(lex, length) == '0')
-    ++length;
-  else
-  {
-    if (char_at(lex, length) < '1' || char_at(lex, length) > '9')
-      return false;
-    ++length;
-    while (isdigit(char_at(lex, length)))
+  int length = 1;
+  if (current(lex) != '0')
+    while (is_digit(char_at(lex, length)))
       ++length;
-  }
   TokenKind kind = TOKEN_KIND_INT;
-  if (char_at(lex, length) == '.')
+  if (char_at(lex, length) == '.' && is_digit(char_at(lex, length + 1)))
   {
     kind = TOKEN_KIND_FLOAT;
-    if (!isdigit(char_at(lex, length + 1)))
-      goto end;
     length += 2;
-    while (isdigit(char_at(lex, length)))
+    while (is_digit(char_at(lex, length)))
       ++length;
   }
   if (char_at(lex, length) == 'e' || char_at(lex, length) == 'E')
   {
+    kind = TOKEN_KIND_FLOAT;
     ++length;
     if (char_at(lex, length) == '+' || char_at(lex, length) == '-')
       ++length;
-    if (!isdigit(char_at(lex, length)))
+    if (!is_digit(char_at(lex, length)))
       return false;
     ++length;
-    while (isdigit(char_at(lex, length)))
+    while (is_digit(char_at(lex, length)))
       ++length;
   }
-  if (isalnum(char_at(lex, length)) || char_at(lex, length) == '_')
+  if (is_ident(char_at(lex, length)))
     return false;
-end:
-  lex->token = token(lex, kind, length, lex->curr);
-  next_chars(lex, length);
+  set_token(lex, kind, length, lex->curr);
+  if (kind == TOKEN_KIND_INT)
+    lex->value.integer = decode_int(lex, length);
+  else
+    lex->value.number = decode_float(lex->curr, length);
+  lex->curr += length;
   return true;
 }
 
+static inline int64_t decode_int(Lexer *lex, int length)
+{
+  int64_t value = 0;
+  for (int i = 0; i < length; ++i)
+  {
+    int digit = char_at(lex, i) - '0';
+    if (value > (INT64_MAX - digit) / 10)
+    {
+      lexical_error(lex, "integer literal too large");
+      return INT64_MAX;
+    }
+    value = value * 10 + digit;
+  }
+  return value;
+}
+
+static inline double decode_float(const char *chars, int length)
+{
+  // Clinger's fast path: when the significand and the power of ten are
+  // both exactly representable, a single multiplication or division is
+  // correctly rounded. Anything else is left to strtod.
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool fraction = false;
+  int i = 0;
+  for (; i < length && chars[i] != 'e' && chars[i] != 'E'; ++i)
+  {
+    if (chars[i] == '.')
+    {
+      fraction = true;
+      continue;
+    }
+    if (digits == 19)
+      return strtod(chars, NULL);
+    mantissa = mantissa * 10 + (uint64_t) (chars[i] - '0');
+    digits += mantissa != 0;
+    exponent -= fraction;
+  }
+  if (i < length)
+  {
+    ++i;
+    bool negative = chars[i] == '-';
+    if (chars[i] == '+' || chars[i] == '-')
+      ++i;
+    int power = 0;
+    for (; i < length; ++i)
+      if (power < 10000)
+        power = power * 10 + (chars[i] - '0');
+    exponent += negative ? -power : power;
+  }
+  if (mantissa > (UINT64_C(1) << 53) || exponent < -22 || exponent > 22)
+    return strtod(chars, NULL);
+  double value = (double) mantissa;
+  return exponent < 0 ? value / powersOfTen[-exponent]
+    : value * powersOfTen[exponent];
+}
+
 static inline bool match_char(Lexer *lex)
 {
-  if (current(lex) != '\'')
-    return false;
-  if (current(lex) == '\'')
+  if (char_at(lex, 1) == '\'')
     return false;
   if (char_at(lex, 1) == '\0')
+  {
     lexical_error(lex, "unclosed char literal");
+    ++lex->curr;
+    set_token(lex, TOKEN_KIND_EOF, 0, lex->curr);
+    return true;
+  }
+  if (char_at(lex, 2) == '\0' && refill(lex, &lex->curr[2]))
+    return match_char(lex);
   if (char_at(lex, 2) != '\'')
     return false;
-  lex->token = token(lex, TOKEN_KIND_CHAR, 1, &lex->curr[1]);
-  next_chars(lex, 3);
+  set_token(lex, TOKEN_KIND_CHAR, 1, &lex->curr[1]);
+  lex->value.code = (uint8_t) char_at(lex, 1);
+  lex->curr += 3;
   return true;
 }
 
-static inline bool match_string(Lexer *lex)
+static inline void match_string(Lexer *lex)
 {
-  if (current(lex) != '\"')
-    return false;
-  int length = 1;
-  for (;;)
+  const char *end = lex->scan.quote(&lex->curr[1]);
+  while (*end == '\0')
   {
-    if (char_at(lex, length) == '\"')
+    size_t scanned = (size_t) (end - lex->curr);
+    if (!refill(lex, end))
     {
-      ++length;
-      break;
-    }
-    if (char_at(lex, length) == '\0')
       lexical_error(lex, "unclosed string literal");
-    ++length;
+      lex->curr = (char *) end;
+      set_token(lex, TOKEN_KIND_EOF, 0, lex->curr);
+      return;
+    }
+    end = lex->scan.quote(&lex->curr[scanned]);
   }
-  lex->token = token(lex, TOKEN_KIND_STRING, length - 2, &lex->curr[1]);
-  next_chars(lex, length);
-  return true;
+  int length = (int) (end - lex->curr) - 1;
+  set_token(lex, TOKEN_KIND_STRING, length, &lex->curr[1]);
+  lex->value.symbol = interner_intern(lex->interner, &lex->curr[1], length);
+  lex->curr = (char *) &end[1];
 }
 
-static inline bool match_ident(Lexer *lex)
+static inline void match_ident(Lexer *lex)
 {
-  if (current(lex) != '_' && !isalpha(current(lex)))
-    return false;
-  int length = 1;
-  while (char_at(lex, length) == '_' || isalnum(char_at(lex, length)))
-    ++length;
-  lex->token = token(lex, TOKEN_KIND_IDENT, length, lex->curr);
-  next_chars(lex, length);
-  return true;
+  int length = (int) (lex->scan.ident(&lex->curr[1]) - lex->curr);
+  TokenKind kind = keyword_kind(lex->curr, length);
+  set_token(lex, kind, length, lex->curr);
+  if (kind == TOKEN_KIND_IDENT)
+    lex->value.symbol = interner_intern(lex->interner, lex->curr, length);
+  lex->curr += length;
 }
 
-static inline Token token(Lexer *lex, TokenKind kind, int length,
-  char *chars)
+static inline TokenKind keyword_kind(const char *chars, int length)
 {
-  return (Token) {
-    .kind = kind,
-    .ln = lex->ln,
-    .col = lex->col,
-    .length = length,
-    .chars = chars
+  switch (chars[0])
+  {
+  case 'a':
+    keyword(chars, length, "as", TOKEN_KIND_AS_KW);
+    break;
+  case 'b':
+    keyword(chars, length, "break", TOKEN_KIND_BREAK_KW);
+    break;
+  case 'c':
+    keyword(chars, length, "case", TOKEN_KIND_CASE_KW);
+    keyword(chars, length, "const", TOKEN_KIND_CONST_KW);
+    keyword(chars, length, "continue", TOKEN_KIND_CONTINUE_KW);
+    break;
+  case 'd':
+    keyword(chars, length, "do", TOKEN_KIND_DO_KW);
+    keyword(chars, length, "default", TOKEN_KIND_DEFAULT_KW);
+    break;
+  case 'e':
+    keyword(chars, length, "else", TOKEN_KIND_ELSE_KW);
+    break;
+  case 'f':
+    keyword(chars, length, "fn", TOKEN_KIND_FN_KW);
+    keyword(chars, length, "for", TOKEN_KIND_FOR_KW);
+    keyword(chars, length, "false", TOKEN_KIND_FALSE_KW);
+    break;
+  case 'i':
+    keyword(chars, length, "if", TOKEN_KIND_IF_KW);
+    keyword(chars, length, "in", TOKEN_KIND_IN_KW);
+    keyword(chars, length, "inout", TOKEN_KIND_INOUT_KW);
+    keyword(chars, length, "import", TOKEN_KIND_IMPORT_KW);
+    keyword(chars, length, "interface", TOKEN_KIND_INTERFACE_KW);
+    break;
+  case 'n':
+    keyword(chars, length, "new", TOKEN_KIND_NEW_KW);
+    break;
+  case 'r':
+    keyword(chars, length, "return", TOKEN_KIND_RETURN_KW);
+    break;
+  case 's':
+    keyword(chars, length, "struct", TOKEN_KIND_STRUCT_KW);
+    keyword(chars, length, "switch", TOKEN_KIND_SWITCH_KW);
+    break;
+  case 't':
+    keyword(chars, length, "try", TOKEN_KIND_TRY_KW);
+    keyword(chars, length, "true", TOKEN_KIND_TRUE_KW);
+    keyword(chars, length, "typealias", TOKEN_KIND_TYPEALIAS_KW);
+    break;
+  case 'v':
+    keyword(chars, length, "var", TOKEN_KIND_VAR_KW);
+    keyword(chars, length, "void", TOKEN_KIND_VOID_KW);
+    break;
+  case 'w':
+    keyword(chars, length, "while", TOKEN_KIND_WHILE_KW);
+    break;
+  }
+  return TOKEN_KIND_IDENT;
+}
+
+static inline bool match_token(Lexer *lex)
+{
+  char c = current(lex);
+  switch (c)
+  {
+  case '\0':
+    set_token(lex, TOKEN_KIND_EOF, 0, lex->curr);
+    return true;
+  case ',':
+    emit(lex, TOKEN_KIND_COMMA, 1);
+    return true;
+  case ';':
+    emit(lex, TOKEN_KIND_SEMICOLON, 1);
+    return true;
+  case ':':
+    emit(lex, TOKEN_KIND_COLON, 1);
+    return true;
+  case '(':
+    emit(lex, TOKEN_KIND_LPAREN, 1);
+    return true;
+  case ')':
+    emit(lex, TOKEN_KIND_RPAREN, 1);
+    return true;
+  case '[':
+    emit(lex, TOKEN_KIND_LBRACKET, 1);
+    return true;
+  case ']':
+    emit(lex, TOKEN_KIND_RBRACKET, 1);
+    return true;
+  case '{':
+    emit(lex, TOKEN_KIND_LBRACE, 1);
+    return true;
+  case '}':
+    emit(lex, TOKEN_KIND_RBRACE, 1);
+    return true;
+  case '|':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_PIPEEQ, 2);
+    else if (char_at(lex, 1) == '|')
+      emit(lex, TOKEN_KIND_PIPEPIPE, 2);
+    else
+      emit(lex, TOKEN_KIND_PIPE, 1);
+    return true;
+  case '&':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_AMPEQ, 2);
+    else if (char_at(lex, 1) == '&')
+      emit(lex, TOKEN_KIND_AMPAMP, 2);
+    else
+      emit(lex, TOKEN_KIND_AMP, 1);
+    return true;
+  case '^':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_CARETEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_CARET, 1);
+    return true;
+  case '=':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_EQEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_EQ, 1);
+    return true;
+  case '!':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_BANGEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_BANG, 1);
+    return true;
+  case '~':
+    emit(lex, TOKEN_KIND_TILDE, 1);
+    return true;
+  case '<':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_LE, 2);
+    else if (char_at(lex, 1) != '<')
+      emit(lex, TOKEN_KIND_LT, 1);
+    else if (char_at(lex, 2) == '=')
+      emit(lex, TOKEN_KIND_LTLTEQ, 3);
+    else
+      emit(lex, TOKEN_KIND_LTLT, 2);
+    return true;
+  case '>':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_GE, 2);
+    else if (char_at(lex, 1) != '>')
+      emit(lex, TOKEN_KIND_GT, 1);
+    else if (char_at(lex, 2) == '=')
+      emit(lex, TOKEN_KIND_GTGTEQ, 3);
+    else
+      emit(lex, TOKEN_KIND_GTGT, 2);
+    return true;
+  case '.':
+    if (char_at(lex, 1) == '.')
+      emit(lex, TOKEN_KIND_DOTDOT, 2);
+    else
+      emit(lex, TOKEN_KIND_DOT, 1);
+    return true;
+  case '+':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_PLUSEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_PLUS, 1);
+    return true;
+  case '-':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_MINUSEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_MINUS, 1);
+    return true;
+  case '*':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_STAREQ, 2);
+    else
+      emit(lex, TOKEN_KIND_STAR, 1);
+    return true;
+  case '/':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_SLASHEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_SLASH, 1);
+    return true;
+  case '%':
+    if (char_at(lex, 1) == '=')
+      emit(lex, TOKEN_KIND_PERCENTEQ, 2);
+    else
+      emit(lex, TOKEN_KIND_PERCENT, 1);
+    return true;
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    if (match_number(lex)) return true;
+    break;
+  case '\'':
+    if (match_char(lex)) return true;
+    break;
+  case '\"':
+    match_string(lex);
+    return true;
+  default:
+    if (!is_alpha(c)) break;
+    match_ident(lex);
+    return true;
+  }
+  c = isprint(c) ? c : '?';
+  lexical_error(lex, "unexpected character '%c' found", c);
+  ++lex->curr;
+  return false;
+}
+
+static inline void keep_text(Lexer *lex)
+{
+  // Tokens must outlive the window they were read from, so their text is
+  // retained and their offsets refer to it instead. The tree points into
+  // this text, so it is kept until the lexer is deinitialized: only the
+  // window is bounded, and the text grows with the input.
+  // The start of the token text in the window is kept for locating it.
+  Token *token = &lex->token;
+  lex->start = &lex->source[token->offset];
+  size_t offset = lex->text.count;
+  buffer_write(&lex->text, token->length, &lex->source[token->offset]);
+  token->offset = (uint32_t) offset;
+}
+
+static inline void set_token(Lexer *lex, TokenKind kind, int length, char *chars)
+{
+  lex->kind = kind;
+  lex->token = (Token) {
+    .offset = (uint32_t) (chars - lex->source),
+    .length = (uint32_t) length
   };
+  lex->value = (TokenValue) { 0 };
 }
 
 static inline void lexical_error(Lexer *lex, const char *fmt, ...)
 {
-  fprintf(stderr, "\nERROR: ");
+  char message[256];
   va_list args;
   va_start(args, fmt);
-  vfprintf(stderr, fmt, args);
+  vsnprintf(message, sizeof(message), fmt, args);
   va_end(args);
-  fprintf(stderr, "\n--> %s:%d:%d\n", lex->file, lex->ln, lex->col);
-  exit(EXIT_FAILURE);
+  int ln;
+  int col;
+  lexer_locate(lex, lex->curr, &ln, &col);
+  diag_report(lex->diags, lex->file, ln, col, "%s", message);
+}
+
+static inline void stream_ensure_capacity(TokenStream *stream, int capacity)
+{
+  if (capacity <= stream->capacity) return;
+  int newCapacity = stream->capacity ? stream->capacity : (1 << 8);
+  while (newCapacity < capacity)
+    newCapacity <<= 1;
+  stream->kinds = realloc(stream->kinds, sizeof(*stream->kinds) * newCapacity);
+  stream->tokens = realloc(stream->tokens, sizeof(*stream->tokens) * newCapacity);
+  stream->values = realloc(stream->values, sizeof(*stream->values) * newCapacity);
+  stream->capacity = newCapacity;
+}
+
+static inline void stream_append(TokenStream *stream, Lexer *lex)
+{
+  int index = stream->count;
+  stream_ensure_capacity(stream, index + 1);
+  stream->kinds[index] = (uint8_t) lex->kind;
+  stream->tokens[index] = lex->token;
+  stream->values[index] = lex->value;
+  ++stream->count;
+}
+
+static inline uint32_t stream_start(TokenStream *stream, int index)
+{
+  // Literal tokens start past their opening quote.
+  TokenKind kind = (TokenKind) stream->kinds[index];
+  uint32_t offset = stream->tokens[index].offset;
+  return kind == TOKEN_KIND_CHAR || kind == TOKEN_KIND_STRING ? offset - 1 : offset;
+}
+
+static inline int stream_search(TokenStream *stream, uint32_t start)
+{
+  // Index of the first token starting at or after start.
+  int lo = 0;
+  int hi = stream->count;
+  while (lo < hi)
+  {
+    int mid = lo + ((hi - lo) >> 1);
+    if (stream_start(stream, mid) < start)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static inline void index_lines(Lexer *lex)
+{
+  int capacity = 1 << 8;
+  uint32_t *lines = malloc(sizeof(*lines) * capacity);
+  int count = 0;
+  const char *chars = lex->source;
+  for (;;)
+  {
+    if (count == capacity)
+    {
+      capacity <<= 1;
+      lines = realloc(lines, sizeof(*lines) * capacity);
+    }
+    lines[count] = (uint32_t) (chars - lex->source);
+    ++count;
+    chars = lex->scan.line(chars);
+    if (*chars == '\0')
+      break;
+    ++chars;
+  }
+  lex->lineCount = count;
+  lex->lines = lines;
 }
 
 const char *token_kind_name(TokenKind kind)
@@ -311,93 +755,238 @@ const char *token_kind_name(TokenKind kind)
   return name;
 }
 
-void lexer_init(Lexer *lex, char *file, char *source)
+void lexer_init(Lexer *lex, char *file, char *source, Interner *interner,
+  DiagList *diags)
 {
-  lex->file = file;
-  lex->source = source;
-  lex->curr = source;
-  lex->ln = 1;
-  lex->col = 1;
+  init(lex, file, source, interner, diags);
+  lexer_next(lex);
+}
+
+void lexer_init_reader(Lexer *lex, char *file, LexerRead read, void *data,
+  Interner *interner, DiagList *diags)
+{
+  size_t capacity = LEXER_CHUNK_SIZE;
+  char *window = calloc(capacity + LEXER_PADDING, 1);
+  init(lex, file, window, interner, diags);
+  lex->read = read;
+  lex->data = data;
+  lex->capacity = capacity;
+  lex->limit = window;
+  lex->end = window;
+  lex->eof = false;
+  buffer_init(&lex->text);
   lexer_next(lex);
 }
 
+void lexer_deinit(Lexer *lex)
+{
+  free(lex->lines);
+  if (!lex->read)
+    return;
+  free(lex->source);
+  free(lex->text.data);
+}
+
 void lexer_next(Lexer *lex)
 {
-  while (skip_space(lex) || skip_comment(lex));
-  if (match(lex, 0, TOKEN_KIND_EOF)) return;
-  if (match(lex, ',', TOKEN_KIND_COMMA)) return;
-  if (match(lex, ';', TOKEN_KIND_SEMICOLON)) return;
-  if (match(lex, ':', TOKEN_KIND_COLON)) return;
-  if (match(lex, '(', TOKEN_KIND_LPAREN)) return;
-  if (match(lex, ')', TOKEN_KIND_RPAREN)) return;
-  if (match(lex, '[', TOKEN_KIND_LBRACKET)) return;
-  if (match(lex, ']', TOKEN_KIND_RBRACKET)) return;
-  if (match(lex, '{', TOKEN_KIND_LBRACE)) return;
-  if (match(lex, '}', TOKEN_KIND_RBRACE)) return;
-  if (match_chars(lex, "|=", TOKEN_KIND_PIPEEQ)) return;
-  if (match_chars(lex, "||", TOKEN_KIND_PIPEPIPE)) return;
-  if (match(lex, '|', TOKEN_KIND_PIPE)) return;
-  if (match_chars(lex, "&=", TOKEN_KIND_AMPEQ)) return;
-  if (match_chars(lex, "&&", TOKEN_KIND_AMPAMP)) return;
-  if (match(lex, '&', TOKEN_KIND_AMP)) return;
-  if (match_chars(lex, "^=", TOKEN_KIND_CARETEQ)) return;
-  if (match(lex, '^', TOKEN_KIND_CARET)) return;
-  if (match_chars(lex, "==", TOKEN_KIND_EQEQ)) return;
-  if (match(lex, '=', TOKEN_KIND_EQ)) return;
-  if (match_chars(lex, "!=", TOKEN_KIND_BANGEQ)) return;
-  if (match(lex, '!', TOKEN_KIND_BANG)) return;
-  if (match(lex, '~', TOKEN_KIND_TILDE)) return;
-  if (match_chars(lex, "<=", TOKEN_KIND_LE)) return;
-  if (match_chars(lex, "<<=", TOKEN_KIND_LTLTEQ)) return;
-  if (match_chars(lex, "<<", TOKEN_KIND_LTLT)) return;
-  if (match(lex, '<', TOKEN_KIND_LT)) return;
-  if (match_chars(lex, ">=", TOKEN_KIND_GE)) return;
-  if (match_chars(lex, ">>=", TOKEN_KIND_GTGTEQ)) return;
-  if (match_chars(lex, ">>", TOKEN_KIND_GTGT)) return;
-  if (match(lex, '>', TOKEN_KIND_GT)) return;
-  if (match_chars(lex, "..", TOKEN_KIND_DOTDOT)) return;
-  if (match(lex, '.', TOKEN_KIND_DOT)) return;
-  if (match_chars(lex, "+=", TOKEN_KIND_PLUSEQ)) return;
-  if (match(lex, '+', TOKEN_KIND_PLUS)) return;
-  if (match_chars(lex, "-=", TOKEN_KIND_MINUSEQ)) return;
-  if (match(lex, '-', TOKEN_KIND_MINUS)) return;
-  if (match_chars(lex, "*=", TOKEN_KIND_STAREQ)) return;
-  if (match(lex, '*', TOKEN_KIND_STAR)) return;
-  if (match_chars(lex, "/=", TOKEN_KIND_SLASHEQ)) return;
-  if (match(lex, '/', TOKEN_KIND_SLASH)) return;
-  if (match_chars(lex, "%=", TOKEN_KIND_PERCENTEQ)) return;
-  if (match(lex, '%', TOKEN_KIND_PERCENT)) return;
-  if (match_number(lex)) return;
-  if (match_char(lex)) return;
-  if (match_string(lex)) return;
-  if (match_keyword(lex, "as", TOKEN_KIND_AS_KW)) return;
-  if (match_keyword(lex, "break", TOKEN_KIND_BREAK_KW)) return;
-  if (match_keyword(lex, "case", TOKEN_KIND_CASE_KW)) return;
-  if (match_keyword(lex, "const", TOKEN_KIND_CONST_KW)) return;
-  if (match_keyword(lex, "continue", TOKEN_KIND_CONTINUE_KW)) return;
-  if (match_keyword(lex, "default", TOKEN_KIND_DEFAULT_KW)) return;
-  if (match_keyword(lex, "do", TOKEN_KIND_DO_KW)) return;
-  if (match_keyword(lex, "else", TOKEN_KIND_ELSE_KW)) return;
-  if (match_keyword(lex, "false", TOKEN_KIND_FALSE_KW)) return;
-  if (match_keyword(lex, "fn", TOKEN_KIND_FN_KW)) return;
-  if (match_keyword(lex, "for", TOKEN_KIND_FOR_KW)) return;
-  if (match_keyword(lex, "if", TOKEN_KIND_IF_KW)) return;
-  if (match_keyword(lex, "import", TOKEN_KIND_IMPORT_KW)) return;
-  if (match_keyword(lex, "in", TOKEN_KIND_IN_KW)) return;
-  if (match_keyword(lex, "inout", TOKEN_KIND_INOUT_KW)) return;
-  if (match_keyword(lex, "interface", TOKEN_KIND_INTERFACE_KW)) return;
-  if (match_keyword(lex, "new", TOKEN_KIND_NEW_KW)) return;
-  if (match_keyword(lex, "return", TOKEN_KIND_RETURN_KW)) return;
-  if (match_keyword(lex, "struct", TOKEN_KIND_STRUCT_KW)) return;
-  if (match_keyword(lex, "switch", TOKEN_KIND_SWITCH_KW)) return;
-  if (match_keyword(lex, "true", TOKEN_KIND_TRUE_KW)) return;
-  if (match_keyword(lex, "try", TOKEN_KIND_TRY_KW)) return;
-  if (match_keyword(lex, "typealias", TOKEN_KIND_TYPEALIAS_KW)) return;
-  if (match_keyword(lex, "var", TOKEN_KIND_VAR_KW)) return;
-  if (match_keyword(lex, "void", TOKEN_KIND_VOID_KW)) return;
-  if (match_keyword(lex, "while", TOKEN_KIND_WHILE_KW)) return;
-  if (match_ident(lex)) return;
-  char c = current(lex);
-  c = isprint(c) ? c : '?';
-  lexical_error(lex, "unexpected character '%c' found", c);
+  for (;;)
+  {
+    skip_space(lex);
+    if (current(lex) == '/' && skip_comment(lex))
+      continue;
+    if (current(lex) == '\0' && refill(lex, lex->curr))
+      continue;
+    lex->start = lex->curr;
+    // Unexpected characters are reported and skipped.
+    if (match_token(lex))
+      break;
+  }
+  if (lex->read)
+    keep_text(lex);
+}
+
+void lexer_seek(Lexer *lex, uint32_t offset)
+{
+  // Resumes at a token start seen before, which only the source allows.
+  assert(!lex->read);
+  lex->curr = &lex->source[offset];
+  lexer_next(lex);
+}
+
+void lexer_skip_block(Lexer *lex)
+{
+  // Skips from the current '{' to the '}' that matches it without lexing
+  // the tokens in between: only braces, literals and comments are told
+  // apart. The matching '}', or the end of the input, becomes the current
+  // token.
+  assert(!lex->read && lex->kind == TOKEN_KIND_LBRACE);
+  const char *chars = lex->curr;
+  int depth = 1;
+  for (;;)
+  {
+    chars = lex->scan.brace(chars);
+    switch (*chars)
+    {
+    case '{':
+      ++depth;
+      ++chars;
+      continue;
+    case '}':
+      if (!--depth)
+        break;
+      ++chars;
+      continue;
+    case '\"':
+      lex->curr = (char *) chars;
+      chars = lex->scan.quote(&chars[1]);
+      if (!*chars)
+      {
+        lexical_error(lex, "unclosed string literal");
+        break;
+      }
+      ++chars;
+      continue;
+    case '\'':
+      lex->curr = (char *) chars;
+      if (!chars[1])
+      {
+        lexical_error(lex, "unclosed char literal");
+        ++chars;
+        break;
+      }
+      chars += chars[1] != '\'' && chars[2] == '\'' ? 3 : 1;
+      continue;
+    case '/':
+      if (chars[1] == '/')
+        chars = lex->scan.line(&chars[2]);
+      else if (chars[1] == '*')
+      {
+        chars = lex->scan.comment(&chars[2]);
+        if (!*chars)
+        {
+          lex->curr = (char *) chars;
+          lexical_error(lex, "unclosed block comment");
+          break;
+        }
+        chars += 2;
+      }
+      else
+        ++chars;
+      continue;
+    default:
+      break;
+    }
+    break;
+  }
+  lex->curr = (char *) chars;
+  lexer_next(lex);
+}
+
+void lexer_tokenize(Lexer *lex, TokenStream *stream)
+{
+  assert(!lex->read);
+  stream->capacity = 0;
+  stream->count = 0;
+  stream->kinds = NULL;
+  stream->tokens = NULL;
+  stream->values = NULL;
+  for (;;)
+  {
+    stream_append(stream, lex);
+    if (lex->kind == TOKEN_KIND_EOF)
+      break;
+    lexer_next(lex);
+  }
+}
+
+void lexer_relex(Lexer *lex, TokenStream *stream, char *source,
+  LexerEdit edit)
+{
+  assert(!lex->read);
+  // Lexing a token may look up to two bytes past its end, so the two
+  // tokens that start before the edit are lexed again as well.
+  int first = stream_search(stream, edit.offset) - 2;
+  uint32_t start = 0;
+  if (first > 0)
+    start = stream_start(stream, first);
+  else
+    first = 0;
+  uint32_t end = edit.offset + edit.inserted;
+  uint32_t delta = edit.inserted - edit.deleted;
+  free(lex->lines);
+  lex->lineCount = 0;
+  lex->lines = NULL;
+  lex->source = source;
+  lex->curr = &source[start];
+  // Once a token past the edit starts where an old one did, the rest of
+  // the old stream is still valid, only shifted by delta. Reaching the end
+  // of input first, which an unclosed literal does from anywhere, leaves
+  // nothing of the old stream to keep.
+  TokenStream tokens = { 0 };
+  stream_ensure_capacity(&tokens, 1);
+  int last = stream->count;
+  for (;;)
+  {
+    lexer_next(lex);
+    stream_append(&tokens, lex);
+    if (lex->kind == TOKEN_KIND_EOF)
+      break;
+    uint32_t offset = stream_start(&tokens, tokens.count - 1);
+    if (offset < end)
+      continue;
+    int index = stream_search(stream, offset - delta);
+    if (index < stream->count && stream_start(stream, index) == offset - delta)
+    {
+      --tokens.count;
+      last = index;
+      break;
+    }
+  }
+  int tail = stream->count - last;
+  int count = first + tokens.count + tail;
+  stream_ensure_capacity(stream, count);
+  int index = first + tokens.count;
+  memmove(&stream->kinds[index], &stream->kinds[last], sizeof(*stream->kinds) * tail);
+  memmove(&stream->tokens[index], &stream->tokens[last], sizeof(*stream->tokens) * tail);
+  memmove(&stream->values[index], &stream->values[last], sizeof(*stream->values) * tail);
+  for (int i = index; i < count; ++i)
+    stream->tokens[i].offset += delta;
+  memcpy(&stream->kinds[first], tokens.kinds, sizeof(*tokens.kinds) * tokens.count);
+  memcpy(&stream->tokens[first], tokens.tokens, sizeof(*tokens.tokens) * tokens.count);
+  memcpy(&stream->values[first], tokens.values, sizeof(*tokens.values) * tokens.count);
+  stream->count = count;
+  free(tokens.kinds);
+  free(tokens.tokens);
+  free(tokens.values);
+}
+
+char *lexer_text(Lexer *lex)
+{
+  return lex->read ? lex->text.data : lex->source;
+}
+
+void lexer_locate(Lexer *lex, const char *chars, int *ln, int *col)
+{
+  if (lex->read)
+  {
+    *ln = lex->baseLn;
+    *col = lex->baseCol;
+    count_lines(lex->source, chars, ln, col);
+    return;
+  }
+  if (!lex->lines)
+    index_lines(lex);
+  uint32_t offset = (uint32_t) (chars - lex->source);
+  int lo = 0;
+  int hi = lex->lineCount - 1;
+  while (lo < hi)
+  {
+    int mid = lo + ((hi - lo + 1) >> 1);
+    if (lex->lines[mid] <= offset)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  *ln = lo + 1;
+  *col = (int) (offset - lex->lines[lo]) + 1;
 }
@@ -11,6 +11,19 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "buffer.h"
+#include "diag.h"
+#include "interner.h"
+#include "scanner.h"
+
+// The source must be followed by at least this many NUL bytes.
+#define LEXER_PADDING SCANNER_WIDTH
+
+#define LEXER_CHUNK_SIZE (1 << 16)
+
 typedef enum
 {
   TOKEN_KIND_EOF,          TOKEN_KIND_COMMA,      TOKEN_KIND_COLON,
@@ -40,27 +53,82 @@ typedef enum
   TOKEN_KIND_WHILE_KW,     TOKEN_KIND_IDENT
 } TokenKind;
 
+#define TOKEN_KIND_COUNT (TOKEN_KIND_IDENT + 1)
+
+typedef union
+{
+  uint32_t symbol;
+  int64_t  integer;
+  double   number;
+  uint32_t code;
+} TokenValue;
+
+// A token is a span of the lexer's text (see lexer_text); its kind and
+// value are kept apart, and its position is derived when needed.
 typedef struct
 {
-  TokenKind kind;
-  int       ln;
-  int       col;
-  int       length;
-  char      *chars;
+  uint32_t offset;
+  uint32_t length;
 } Token;
 
+typedef size_t (*LexerRead)(void *data, char *chars, size_t size);
+
 typedef struct
 {
-  char  *file;
-  char  *source;
-  char  *curr;
-  int   ln;
-  int   col;
-  Token token;
+  char       *file;
+  char       *source;
+  char       *curr;
+  char       *start;
+  Interner   *interner;
+  Scanner    scan;
+  TokenKind  kind;
+  Token      token;
+  TokenValue value;
+  int        lineCount;
+  uint32_t   *lines;
+  LexerRead  read;
+  void       *data;
+  size_t     capacity;
+  char       *limit;
+  char       *end;
+  char       saved;
+  bool       eof;
+  int        baseLn;
+  int        baseCol;
+  Buffer     text;
+  DiagList   *diags;
 } Lexer;
 
+typedef struct
+{
+  int        capacity;
+  int        count;
+  uint8_t    *kinds;
+  Token      *tokens;
+  TokenValue *values;
+} TokenStream;
+
+// An edit replaces `deleted` bytes at `offset` with `inserted` bytes.
+typedef struct
+{
+  uint32_t offset;
+  uint32_t deleted;
+  uint32_t inserted;
+} LexerEdit;
+
 const char *token_kind_name(TokenKind kind);
-void lexer_init(Lexer *lex, char *file, char *source);
+void lexer_init(Lexer *lex, char *file, char *source, Interner *interner,
+  DiagList *diags);
+void lexer_init_reader(Lexer *lex, char *file, LexerRead read, void *data,
+  Interner *interner, DiagList *diags);
+void lexer_deinit(Lexer *lex);
 void lexer_next(Lexer *lex);
+void lexer_seek(Lexer *lex, uint32_t offset);
+void lexer_skip_block(Lexer *lex);
+void lexer_tokenize(Lexer *lex, TokenStream *stream);
+void lexer_relex(Lexer *lex, TokenStream *stream, char *source,
+  LexerEdit edit);
+char *lexer_text(Lexer *lex);
+void lexer_locate(Lexer *lex, const char *chars, int *ln, int *col);
 
 #endif // LEXER_H
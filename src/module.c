@@ -0,0 +1,440 @@
+//
+// module.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "module.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "cache.h"
+
+static inline char *canonical_path(const char *path);
+static inline int dir_length(const char *path);
+static inline char *resolve_path(ModuleGraph *graph, const char *from,
+  const char *name);
+static inline int add_module(ModuleGraph *graph, char *path);
+static inline bool load_module(Module *module);
+static inline void unload_module(Module *module);
+static inline bool module_changed(Module *module);
+static inline void reload_module(ModuleGraph *graph, int index);
+static inline void add_import(ModuleGraph *graph, Module *module,
+  AstNode *node);
+static inline void import_error(Module *module, AstLeafNode *leaf,
+  const char *fmt, const char *name);
+static inline void enqueue(ModuleGraph *graph, int index);
+static inline void parse_module(ModuleGraph *graph, Module *module);
+static void work(void *data);
+
+static inline char *canonical_path(const char *path)
+{
+#ifdef _WIN32
+  char *fullPath = _fullpath(NULL, path, 0);
+  if (fullPath && GetFileAttributesA(fullPath) == INVALID_FILE_ATTRIBUTES)
+  {
+    free(fullPath);
+    return NULL;
+  }
+  return fullPath;
+#else
+  return realpath(path, NULL);
+#endif
+}
+
+static inline int dir_length(const char *path)
+{
+  int length = 0;
+  for (int i = 0; path[i]; ++i)
+  {
+#ifdef _WIN32
+    if (path[i] == '\\')
+      length = i + 1;
+#endif
+    if (path[i] == '/')
+      length = i + 1;
+  }
+  return length;
+}
+
+static inline char *resolve_path(ModuleGraph *graph, const char *from,
+  const char *name)
+{
+  // Names starting with ./ or ../ are relative to the importing module, and
+  // any other name to the directory of the first root.
+  const char *dir = graph->rootDir;
+  int dirLength = (int) strlen(dir);
+  if (!strncmp(name, "./", 2) || !strncmp(name, "../", 3))
+  {
+    dir = from;
+    dirLength = dir_length(from);
+  }
+  size_t length = strlen(name);
+  size_t extLength = sizeof(MODULE_EXT) - 1;
+  const char *ext = MODULE_EXT;
+  if (length >= extLength && !strcmp(&name[length - extLength], MODULE_EXT))
+    ext = "";
+  char path[4096];
+  snprintf(path, sizeof(path), "%.*s%s%s", dirLength, dir, name, ext);
+  return canonical_path(path);
+}
+
+static inline int add_module(ModuleGraph *graph, char *path)
+{
+  // Must be called with the lock held.
+  int index = (int) interner_intern(&graph->paths, path, (int) strlen(path));
+  if (index < graph->count)
+    return index;
+  if (graph->count == graph->capacity)
+  {
+    int capacity = graph->capacity << 1;
+    graph->modules = realloc(graph->modules, sizeof(*graph->modules) * capacity);
+    graph->queue = realloc(graph->queue, sizeof(*graph->queue) * capacity);
+    graph->capacity = capacity;
+  }
+  Module *module = calloc(1, sizeof(*module));
+  module->path = interner_symbol(&graph->paths, (uint32_t) index)->chars;
+  graph->modules[index] = module;
+  ++graph->count;
+  return index;
+}
+
+static inline bool load_module(Module *module)
+{
+  struct stat st;
+  if (stat(module->path, &st) || !source_load(&module->src, module->path))
+    return false;
+  module->mtime = (int64_t) st.st_mtime;
+  module->size = (int64_t) st.st_size;
+  module->checked = (int64_t) time(NULL);
+  module->hash = cache_hash(module->src.chars, module->src.length);
+  return true;
+}
+
+static inline void unload_module(Module *module)
+{
+  if (module->ast)
+  {
+    parser_deinit(&module->parser);
+    interner_deinit(&module->interner);
+    module->ast = NULL;
+  }
+  if (module->src.chars)
+  {
+    source_unload(&module->src);
+    module->src.chars = NULL;
+  }
+  module->importCount = 0;
+  module->importFailed = false;
+}
+
+static inline bool module_changed(Module *module)
+{
+  // The time and size are trusted only if the file was last written before
+  // it was checked, since a later write within the same second would not
+  // change its time. Otherwise, the source is hashed again.
+  struct stat st;
+  bool exists = !stat(module->path, &st);
+  if (!module->src.chars || !exists)
+    return exists || module->src.chars;
+  if ((int64_t) st.st_mtime == module->mtime
+    && (int64_t) st.st_size == module->size && module->mtime < module->checked)
+    return false;
+  Source src;
+  if (!source_load(&src, module->path))
+    return true;
+  uint64_t hash = cache_hash(src.chars, src.length);
+  source_unload(&src);
+  if (hash != module->hash)
+    return true;
+  module->mtime = (int64_t) st.st_mtime;
+  module->size = (int64_t) st.st_size;
+  module->checked = (int64_t) time(NULL);
+  return false;
+}
+
+static inline void reload_module(ModuleGraph *graph, int index)
+{
+  Module *module = graph->modules[index];
+  unload_module(module);
+  if (load_module(module))
+    enqueue(graph, index);
+}
+
+static inline void add_import(ModuleGraph *graph, Module *module,
+  AstNode *node)
+{
+  AstLeafNode *leaf = (AstLeafNode *) node;
+  char *name = interner_symbol(&module->interner, leaf->value.symbol)->chars;
+  char *path = resolve_path(graph, module->path, name);
+  if (!path)
+  {
+    import_error(module, leaf, "cannot find module '%s'", name);
+    return;
+  }
+  mutex_lock(&graph->lock);
+  int count = graph->count;
+  int index = add_module(graph, path);
+  Module *imported = graph->modules[index];
+  bool added = index >= count;
+  if (added)
+    imported->loading = true;
+  mutex_unlock(&graph->lock);
+  free(path);
+  if (module->importCount == module->importCapacity)
+  {
+    int capacity = module->importCapacity ? module->importCapacity << 1 : 4;
+    module->imports = realloc(module->imports,
+      sizeof(*module->imports) * capacity);
+    module->importCapacity = capacity;
+  }
+  module->imports[module->importCount++] = index;
+  // Only the import that added the module loads and queues it, so every
+  // module is loaded and queued once. The other imports wait for the load
+  // to tell whether it failed.
+  bool loaded;
+  if (added)
+  {
+    loaded = load_module(imported);
+    mutex_lock(&graph->lock);
+    imported->loading = false;
+    cond_broadcast(&graph->ready);
+    mutex_unlock(&graph->lock);
+  }
+  else
+  {
+    mutex_lock(&graph->lock);
+    while (imported->loading)
+      cond_wait(&graph->ready, &graph->lock);
+    loaded = imported->src.chars != NULL;
+    mutex_unlock(&graph->lock);
+  }
+  if (!loaded)
+  {
+    import_error(module, leaf, "cannot open module '%s'", name);
+    return;
+  }
+  if (added)
+    enqueue(graph, index);
+}
+
+static inline void import_error(Module *module, AstLeafNode *leaf,
+  const char *fmt, const char *name)
+{
+  Lexer *lex = &module->parser.lex;
+  int ln;
+  int col;
+  // The token of a string starts past its opening quote.
+  lexer_locate(lex, &lexer_text(lex)[leaf->token.offset - 1], &ln, &col);
+  diag_report(&module->parser.diags, module->path, ln, col, fmt, name);
+  module->importFailed = true;
+}
+
+static inline void enqueue(ModuleGraph *graph, int index)
+{
+  mutex_lock(&graph->lock);
+  graph->queue[graph->tail++] = index;
+  ++graph->pending;
+  cond_signal(&graph->ready);
+  mutex_unlock(&graph->lock);
+}
+
+static inline void parse_module(ModuleGraph *graph, Module *module)
+{
+  interner_init(&module->interner);
+  parser_init(&module->parser, module->path, module->src.chars,
+    &module->interner, graph->flags);
+  AstNonLeafNode *ast = (AstNonLeafNode *) parser_parse(&module->parser);
+  module->ast = (AstNode *) ast;
+  if (!graph->followImports)
+    return;
+  for (int i = 0; i < ast->count; ++i)
+  {
+    AstNode *decl = ast->children[i];
+    if (decl->kind == AST_NODE_KIND_RENAME)
+      decl = ((AstNonLeafNode *) decl)->children[0];
+    if (decl->kind == AST_NODE_KIND_IMPORT_DECL)
+      add_import(graph, module, ((AstNonLeafNode *) decl)->children[0]);
+  }
+}
+
+static void work(void *data)
+{
+  // A module stays pending until its imports are queued, so the queue can
+  // only run dry for good once nothing is pending.
+  ModuleGraph *graph = data;
+  mutex_lock(&graph->lock);
+  for (;;)
+  {
+    while (graph->head == graph->tail && graph->pending)
+      cond_wait(&graph->ready, &graph->lock);
+    if (graph->head == graph->tail)
+      break;
+    Module *module = graph->modules[graph->queue[graph->head++]];
+    mutex_unlock(&graph->lock);
+    parse_module(graph, module);
+    mutex_lock(&graph->lock);
+    if (!--graph->pending)
+      cond_broadcast(&graph->ready);
+  }
+  mutex_unlock(&graph->lock);
+}
+
+void module_graph_init(ModuleGraph *graph, int flags)
+{
+  int capacity = MODULE_GRAPH_MIN_CAPACITY;
+  graph->flags = flags;
+  graph->followImports = true;
+  mutex_init(&graph->lock);
+  cond_init(&graph->ready);
+  interner_init(&graph->paths);
+  graph->rootDir = NULL;
+  graph->capacity = capacity;
+  graph->count = 0;
+  graph->modules = malloc(sizeof(*graph->modules) * capacity);
+  graph->queue = malloc(sizeof(*graph->queue) * capacity);
+  graph->head = 0;
+  graph->tail = 0;
+  graph->pending = 0;
+}
+
+void module_graph_deinit(ModuleGraph *graph)
+{
+  for (int i = 0; i < graph->count; ++i)
+  {
+    Module *module = graph->modules[i];
+    unload_module(module);
+    free(module->imports);
+    free(module);
+  }
+  mutex_deinit(&graph->lock);
+  cond_deinit(&graph->ready);
+  interner_deinit(&graph->paths);
+  free(graph->rootDir);
+  free(graph->modules);
+  free(graph->queue);
+}
+
+void module_graph_refresh(ModuleGraph *graph)
+{
+  // Besides the modules that changed, a module is parsed again when one of
+  // its imports failed, since the import may now succeed, or when one of
+  // its imports can no longer be loaded.
+  int count = graph->count;
+  graph->head = 0;
+  graph->tail = 0;
+  bool *changed = malloc(sizeof(*changed) * (count ? count : 1));
+  for (int i = 0; i < count; ++i)
+  {
+    changed[i] = module_changed(graph->modules[i]);
+    if (changed[i])
+      reload_module(graph, i);
+  }
+  for (int i = 0; i < count; ++i)
+  {
+    Module *module = graph->modules[i];
+    if (changed[i])
+      continue;
+    bool stale = module->importFailed;
+    for (int j = 0; !stale && j < module->importCount; ++j)
+    {
+      int index = module->imports[j];
+      stale = changed[index] && !graph->modules[index]->src.chars;
+    }
+    if (stale)
+      reload_module(graph, i);
+  }
+  free(changed);
+}
+
+int module_graph_add_root(ModuleGraph *graph, const char *file)
+{
+  // Returns the index of the root, or -1 if it cannot be loaded.
+  char *path = canonical_path(file);
+  if (!path)
+    return -1;
+  int count = graph->count;
+  int index = add_module(graph, path);
+  free(path);
+  Module *root = graph->modules[index];
+  if (!graph->rootDir)
+  {
+    int length = dir_length(root->path);
+    graph->rootDir = malloc(length + 1);
+    memcpy(graph->rootDir, root->path, length);
+    graph->rootDir[length] = '\0';
+  }
+  if (index < count)
+    return root->src.chars ? index : -1;
+  if (!load_module(root))
+    return -1;
+  enqueue(graph, index);
+  return index;
+}
+
+void module_graph_parse(ModuleGraph *graph, int threadCount)
+{
+  // The calling thread is one of the workers.
+  Thread *threads = malloc(sizeof(*threads) * threadCount);
+  int count = 0;
+  for (int i = 1; i < threadCount; ++i)
+    if (thread_start(&threads[count], work, graph))
+      ++count;
+  work(graph);
+  for (int i = 0; i < count; ++i)
+    thread_join(threads[i]);
+  free(threads);
+}
+
+int module_graph_order(ModuleGraph *graph, int rootCount, const int *roots,
+  int *order)
+{
+  // Orders the modules reachable from the roots so that each one comes
+  // after the modules it imports, walking the imports depth-first from each
+  // root in turn with an explicit stack. An import cycle is cut where it
+  // closes.
+  if (!graph->count)
+    return 0;
+  bool *visited = calloc(graph->count, sizeof(*visited));
+  int *stack = malloc(sizeof(*stack) * graph->count);
+  int *nexts = malloc(sizeof(*nexts) * graph->count);
+  int count = 0;
+  for (int i = 0; i < rootCount; ++i)
+  {
+    int root = roots[i];
+    if (visited[root])
+      continue;
+    stack[0] = root;
+    nexts[0] = 0;
+    visited[root] = true;
+    int top = 1;
+    while (top)
+    {
+      Module *module = graph->modules[stack[top - 1]];
+      int next = nexts[top - 1];
+      if (next == module->importCount)
+      {
+        order[count++] = stack[--top];
+        continue;
+      }
+      ++nexts[top - 1];
+      int index = module->imports[next];
+      if (visited[index])
+        continue;
+      visited[index] = true;
+      stack[top] = index;
+      nexts[top] = 0;
+      ++top;
+    }
+  }
+  free(visited);
+  free(stack);
+  free(nexts);
+  return count;
+}
@@ -0,0 +1,76 @@
+//
+// module.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stdint.h>
+#include "parser.h"
+#include "source.h"
+#include "thread.h"
+
+#define MODULE_EXT ".pwc"
+
+#define MODULE_GRAPH_MIN_CAPACITY (1 << 4)
+
+// A module owns its source, interner and parser, so that modules can be
+// parsed on different threads without sharing any state. The ast is null
+// when the source could not be loaded. The time and size of the file and
+// the hash of its source tell whether it changed since it was loaded. A
+// module is loading while the import that added it loads its source.
+typedef struct
+{
+  char     *path;
+  Source   src;
+  int64_t  mtime;
+  int64_t  size;
+  int64_t  checked;
+  uint64_t hash;
+  bool     loading;
+  bool     importFailed;
+  Interner interner;
+  Parser   parser;
+  AstNode  *ast;
+  int      importCapacity;
+  int      importCount;
+  int      *imports;
+} Module;
+
+// Modules are numbered in the order they are first met, as a root or an
+// import, and the graph is grown by the workers as they resolve the imports
+// of the modules they parse. Paths are canonical, so each file is parsed
+// once however many roots import it. A graph can be kept and refreshed, so
+// that only the modules that changed are parsed again.
+typedef struct
+{
+  int      flags;
+  bool     followImports;
+  Mutex    lock;
+  Cond     ready;
+  Interner paths;
+  char     *rootDir;
+  int      capacity;
+  int      count;
+  Module   **modules;
+  int      *queue;
+  int      head;
+  int      tail;
+  int      pending;
+} ModuleGraph;
+
+void module_graph_init(ModuleGraph *graph, int flags);
+void module_graph_deinit(ModuleGraph *graph);
+void module_graph_refresh(ModuleGraph *graph);
+int module_graph_add_root(ModuleGraph *graph, const char *file);
+void module_graph_parse(ModuleGraph *graph, int threadCount);
+int module_graph_order(ModuleGraph *graph, int rootCount, const int *roots,
+  int *order);
+
+#endif // MODULE_H
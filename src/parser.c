@@ -13,13 +13,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#define current(p) ((p)->lex.token)
+#define current(p) ((p)->token)
 
-#define match(p, t) (current(p).kind == (t))
+#define match(p, t) ((p)->kind == (t))
 
 #define next(p) \
   do { \
-    lexer_next(&(p)->lex); \
+    next_token(p); \
   } while (0)
 
 #define consume(p, t) \
@@ -29,7 +29,91 @@
     next(p); \
   } while (0)
 
+typedef enum
+{
+  PREC_NONE,
+  PREC_ASSIGN,
+  PREC_OR,
+  PREC_AND,
+  PREC_BOR,
+  PREC_BXOR,
+  PREC_BAND,
+  PREC_EQ,
+  PREC_COMP,
+  PREC_SHIFT,
+  PREC_RANGE,
+  PREC_ADD,
+  PREC_MUL,
+  PREC_UNARY
+} Precedence;
+
+typedef struct
+{
+  Precedence  prec;
+  AstNodeKind kind;
+} Operator;
+
+// Operators by token kind, where PREC_NONE marks a token that is not one.
+// Binary operators are left-associative, except for ranges, which do not
+// associate, and assignments, which associate to the right.
+static const Operator assignOps[TOKEN_KIND_COUNT] = {
+  [TOKEN_KIND_EQ]        = { PREC_ASSIGN, AST_NODE_KIND_ASSIGN },
+  [TOKEN_KIND_PIPEEQ]    = { PREC_ASSIGN, AST_NODE_KIND_BOR_ASSIGN },
+  [TOKEN_KIND_CARETEQ]   = { PREC_ASSIGN, AST_NODE_KIND_BXOR_ASSIGN },
+  [TOKEN_KIND_AMPEQ]     = { PREC_ASSIGN, AST_NODE_KIND_BAND_ASSIGN },
+  [TOKEN_KIND_LTLTEQ]    = { PREC_ASSIGN, AST_NODE_KIND_SHL_ASSIGN },
+  [TOKEN_KIND_GTGTEQ]    = { PREC_ASSIGN, AST_NODE_KIND_SHR_ASSIGN },
+  [TOKEN_KIND_PLUSEQ]    = { PREC_ASSIGN, AST_NODE_KIND_ADD_ASSIGN },
+  [TOKEN_KIND_MINUSEQ]   = { PREC_ASSIGN, AST_NODE_KIND_SUB_ASSIGN },
+  [TOKEN_KIND_STAREQ]    = { PREC_ASSIGN, AST_NODE_KIND_MUL_ASSIGN },
+  [TOKEN_KIND_SLASHEQ]   = { PREC_ASSIGN, AST_NODE_KIND_DIV_ASSIGN },
+  [TOKEN_KIND_PERCENTEQ] = { PREC_ASSIGN, AST_NODE_KIND_MOD_ASSIGN }
+};
+
+static const Operator binaryOps[TOKEN_KIND_COUNT] = {
+  [TOKEN_KIND_PIPEPIPE] = { PREC_OR,    AST_NODE_KIND_OR },
+  [TOKEN_KIND_AMPAMP]   = { PREC_AND,   AST_NODE_KIND_AND },
+  [TOKEN_KIND_PIPE]     = { PREC_BOR,   AST_NODE_KIND_BOR },
+  [TOKEN_KIND_CARET]    = { PREC_BXOR,  AST_NODE_KIND_BXOR },
+  [TOKEN_KIND_AMP]      = { PREC_BAND,  AST_NODE_KIND_BAND },
+  [TOKEN_KIND_EQEQ]     = { PREC_EQ,    AST_NODE_KIND_EQ },
+  [TOKEN_KIND_BANGEQ]   = { PREC_EQ,    AST_NODE_KIND_NE },
+  [TOKEN_KIND_LT]       = { PREC_COMP,  AST_NODE_KIND_LT },
+  [TOKEN_KIND_LE]       = { PREC_COMP,  AST_NODE_KIND_LE },
+  [TOKEN_KIND_GT]       = { PREC_COMP,  AST_NODE_KIND_GT },
+  [TOKEN_KIND_GE]       = { PREC_COMP,  AST_NODE_KIND_GE },
+  [TOKEN_KIND_LTLT]     = { PREC_SHIFT, AST_NODE_KIND_SHL },
+  [TOKEN_KIND_GTGT]     = { PREC_SHIFT, AST_NODE_KIND_SHR },
+  [TOKEN_KIND_DOTDOT]   = { PREC_RANGE, AST_NODE_KIND_RANGE },
+  [TOKEN_KIND_PLUS]     = { PREC_ADD,   AST_NODE_KIND_ADD },
+  [TOKEN_KIND_MINUS]    = { PREC_ADD,   AST_NODE_KIND_SUB },
+  [TOKEN_KIND_STAR]     = { PREC_MUL,   AST_NODE_KIND_MUL },
+  [TOKEN_KIND_SLASH]    = { PREC_MUL,   AST_NODE_KIND_DIV },
+  [TOKEN_KIND_PERCENT]  = { PREC_MUL,   AST_NODE_KIND_MOD }
+};
+
+static const Operator unaryOps[TOKEN_KIND_COUNT] = {
+  [TOKEN_KIND_BANG]  = { PREC_UNARY, AST_NODE_KIND_NOT },
+  [TOKEN_KIND_MINUS] = { PREC_UNARY, AST_NODE_KIND_NEG },
+  [TOKEN_KIND_TILDE] = { PREC_UNARY, AST_NODE_KIND_BNOT }
+};
+
+static inline void next_token(Parser *parser);
+static inline void stream_token(Parser *parser);
+static inline void lexer_token(Parser *parser);
+static inline void seek_token(Parser *parser, uint32_t offset);
 static inline void unexpected_token_error(Parser *parser);
+static inline AstNode *type_leaf_node(Parser *parser, AstNodeKind kind);
+static inline bool is_sync_token(Parser *parser, bool nested);
+static inline void synchronize(Parser *parser, uint32_t start, bool nested);
+static inline AstNode *parse_recovering(Parser *parser,
+  AstNode *(*parse)(Parser *), bool nested);
+static inline void scratch_init(Parser *parser);
+static inline AstNode *leaf_node(Parser *parser, AstNodeKind kind);
+static inline void push_node(Parser *parser, AstNode *node);
+static inline AstNode *pop_nodes(Parser *parser, AstNodeKind kind, int base);
+static inline AstNode *pop_type_nodes(Parser *parser, AstNodeKind kind,
+  int base);
 static inline AstNode *parse_module(Parser *parser);
 static inline AstNode *parse_decl(Parser *parser);
 static inline AstNode *parse_import_decl(Parser *parser);
@@ -43,6 +127,7 @@ static inline AstNode *parse_type_def(Parser *parser);
 static inline AstNode *parse_func_decl(Parser *parser, bool isAnon);
 static inline AstNode *parse_param(Parser *parser);
 static inline AstNode *parse_block(Parser *parser);
+static inline AstNode *skip_block(Parser *parser);
 static inline AstNode *parse_struct_decl(Parser *parser);
 static inline AstNode *parse_struct_member(Parser *parser);
 static inline AstNode *parse_interface_decl(Parser *parser);
@@ -59,17 +144,9 @@ static inline AstNode *parse_break_stmt(Parser *parser);
 static inline AstNode *parse_continue_stmt(Parser *parser);
 static inline AstNode *parse_return_stmt(Parser *parser);
 static inline AstNode *parse_expr(Parser *parser);
-static inline AstNode *parse_or_expr(Parser *parser);
-static inline AstNode *parse_and_expr(Parser *parser);
-static inline AstNode *parse_bor_expr(Parser *parser);
-static inline AstNode *parse_bxor_expr(Parser *parser);
-static inline AstNode *parse_band_expr(Parser *parser);
-static inline AstNode *parse_eq_expr(Parser *parser);
-static inline AstNode *parse_comp_expr(Parser *parser);
-static inline AstNode *parse_shift_expr(Parser *parser);
-static inline AstNode *parse_range_expr(Parser *parser);
-static inline AstNode *parse_add_expr(Parser *parser);
-static inline AstNode *parse_mul_expr(Parser *parser);
+static inline AstNode *binary_node(Parser *parser, AstNodeKind kind,
+  AstNode *lhs, AstNode *rhs);
+static inline AstNode *parse_binary_expr(Parser *parser, Precedence minPrec);
 static inline AstNode *parse_unary_expr(Parser *parser);
 static inline AstNode *parse_prim_expr(Parser *parser);
 static inline AstNode *parse_array_expr(Parser *parser);
@@ -81,30 +158,219 @@ static inline AstNode *parse_call(Parser *parser, AstNode *lhs);
 static inline AstNode *parse_subscr(Parser *parser, AstNode *lhs);
 static inline AstNode *parse_if_expr(Parser *parser);
 
+static inline void next_token(Parser *parser)
+{
+  if (parser->flags & PARSER_FLAG_PRETOKENIZE)
+  {
+    ++parser->index;
+    stream_token(parser);
+    return;
+  }
+  lexer_next(&parser->lex);
+  lexer_token(parser);
+}
+
+static inline void stream_token(Parser *parser)
+{
+  TokenStream *stream = &parser->stream;
+  int index = parser->index;
+  if (index >= stream->count)
+    index = parser->index = stream->count - 1;
+  parser->kind = (TokenKind) stream->kinds[index];
+  parser->token = stream->tokens[index];
+  parser->value = stream->values[index];
+}
+
+static inline void lexer_token(Parser *parser)
+{
+  Lexer *lex = &parser->lex;
+  parser->kind = lex->kind;
+  parser->token = lex->token;
+  parser->value = lex->value;
+}
+
+static inline void seek_token(Parser *parser, uint32_t offset)
+{
+  if (!(parser->flags & PARSER_FLAG_PRETOKENIZE))
+  {
+    lexer_seek(&parser->lex, offset);
+    lexer_token(parser);
+    return;
+  }
+  TokenStream *stream = &parser->stream;
+  int lo = 0;
+  int hi = stream->count - 1;
+  while (lo < hi)
+  {
+    int mid = lo + ((hi - lo) >> 1);
+    if (stream->tokens[mid].offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  parser->index = lo;
+  stream_token(parser);
+}
+
 static inline void unexpected_token_error(Parser *parser)
 {
   Lexer *lex = &parser->lex;
-  Token *token = &lex->token;
-  if (token->kind == TOKEN_KIND_EOF)
+  Token *token = &parser->token;
+  char *chars = &lexer_text(lex)[token->offset];
+  // Tokens read from a reader no longer point into the source, but the
+  // lexer keeps where the current one was found there. Literal tokens
+  // start past their opening quote.
+  char *start = lex->read ? lex->start : chars;
+  if (parser->kind == TOKEN_KIND_CHAR || parser->kind == TOKEN_KIND_STRING)
+    --start;
+  int ln;
+  int col;
+  lexer_locate(lex, start, &ln, &col);
+  // A token that ends a construct early is met again by every enclosing
+  // one that expected to close there, so it is reported once.
+  DiagList *diags = &parser->diags;
+  Diagnostic *last = diags->count ? &diags->items[diags->count - 1] : NULL;
+  if (last && last->ln == ln && last->col == col)
+    goto end;
+  if (parser->kind == TOKEN_KIND_EOF)
   {
-    fprintf(stderr, "\nERROR: unexpected end of file\n");
+    diag_report(diags, lex->file, ln, col, "unexpected end of file");
     goto end;
   }
-  fprintf(stderr, "\nERROR: unexpected token '%.*s'\n", token->length, token->chars);
+  diag_report(diags, lex->file, ln, col, "unexpected token '%.*s'",
+    (int) token->length, chars);
 end:
-  fprintf(stderr, "--> %s:%d:%d\n", lex->file, token->ln, token->col);
-  exit(EXIT_FAILURE);
+  longjmp(*parser->recover, 1);
+}
+
+static inline AstNode *leaf_node(Parser *parser, AstNodeKind kind)
+{
+  return (AstNode *) ast_leaf_node_new(&parser->arena, kind, parser->token,
+    parser->value);
+}
+
+static inline AstNode *type_leaf_node(Parser *parser, AstNodeKind kind)
+{
+  return type_table_leaf(&parser->types, &parser->arena, kind, parser->token,
+    parser->value);
+}
+
+static inline bool is_sync_token(Parser *parser, bool nested)
+{
+  switch (parser->kind)
+  {
+  case TOKEN_KIND_RBRACE:
+    return nested;
+  case TOKEN_KIND_IMPORT_KW:
+  case TOKEN_KIND_TYPEALIAS_KW:
+  case TOKEN_KIND_FN_KW:
+  case TOKEN_KIND_STRUCT_KW:
+  case TOKEN_KIND_INTERFACE_KW:
+  case TOKEN_KIND_CONST_KW:
+  case TOKEN_KIND_VAR_KW:
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline void synchronize(Parser *parser, uint32_t start, bool nested)
+{
+  // Skips to just past a ';', or up to a '}' closing the enclosing block or
+  // a declaration keyword. At least one token is skipped when the failed
+  // construct consumed none, so that the caller always makes progress.
+  bool moved = parser->token.offset != start;
+  while (!match(parser, TOKEN_KIND_EOF))
+  {
+    if (match(parser, TOKEN_KIND_SEMICOLON))
+    {
+      next(parser);
+      return;
+    }
+    if (moved && is_sync_token(parser, nested))
+      return;
+    next(parser);
+    moved = true;
+  }
+}
+
+static inline AstNode *parse_recovering(Parser *parser,
+  AstNode *(*parse)(Parser *), bool nested)
+{
+  // Syntax errors unwind to here, where an error node takes the place of
+  // the statement or declaration that failed.
+  jmp_buf *outer = parser->recover;
+  jmp_buf recover;
+  int base = parser->scratchCount;
+  Token token = parser->token;
+  AstNode *node;
+  parser->recover = &recover;
+  if (!setjmp(recover))
+    node = parse(parser);
+  else
+  {
+    parser->scratchCount = base;
+    synchronize(parser, token.offset, nested);
+    node = (AstNode *) ast_leaf_node_new(&parser->arena, AST_NODE_KIND_ERROR,
+      token, (TokenValue) { 0 });
+  }
+  parser->recover = outer;
+  return node;
+}
+
+static inline void scratch_init(Parser *parser)
+{
+  int capacity = PARSER_SCRATCH_MIN_CAPACITY;
+  parser->scratchCapacity = capacity;
+  parser->scratchCount = 0;
+  parser->scratch = malloc(sizeof(*parser->scratch) * capacity);
+}
+
+static inline void push_node(Parser *parser, AstNode *node)
+{
+  if (parser->scratchCount == parser->scratchCapacity)
+  {
+    int newCapacity = parser->scratchCapacity << 1;
+    AstNode **newScratch = realloc(parser->scratch, sizeof(*newScratch) * newCapacity);
+    parser->scratchCapacity = newCapacity;
+    parser->scratch = newScratch;
+  }
+  parser->scratch[parser->scratchCount] = node;
+  ++parser->scratchCount;
+}
+
+static inline AstNode *pop_nodes(Parser *parser, AstNodeKind kind, int base)
+{
+  // Lists are collected on the scratch stack, so that their node gets a
+  // children array of the exact size.
+  int count = parser->scratchCount - base;
+  AstNonLeafNode *node = ast_nonleaf_node_new_with_children(&parser->arena, kind,
+    count, &parser->scratch[base]);
+  parser->scratchCount = base;
+  return (AstNode *) node;
+}
+
+static inline AstNode *pop_type_nodes(Parser *parser, AstNodeKind kind,
+  int base)
+{
+  // Type nodes are shared, so they must never be appended to afterwards.
+  int count = parser->scratchCount - base;
+  AstNode *node = type_table_nonleaf(&parser->types, &parser->arena, kind,
+    count, &parser->scratch[base]);
+  parser->scratchCount = base;
+  return node;
 }
 
 static inline AstNode *parse_module(Parser *parser)
 {
-  AstNonLeafNode *module = ast_nonleaf_node_new(AST_NODE_KIND_MODULE);
+  int base = parser->scratchCount;
   while (!match(parser, TOKEN_KIND_EOF))
   {
-    AstNode *decl = parse_decl(parser);
-    ast_nonleaf_node_append_child(module, decl);
+    AstNode *decl = parse_recovering(parser, parse_decl, false);
+    push_node(parser, decl);
   }
-  return (AstNode *) module;
+  return pop_nodes(parser, AST_NODE_KIND_MODULE, base);
 }
 
 static inline AstNode *parse_decl(Parser *parser)
@@ -130,11 +396,10 @@ static inline AstNode *parse_import_decl(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_STRING))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNonLeafNode *importDecl = ast_nonleaf_node_new(AST_NODE_KIND_IMPORT_DECL);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
-  ast_nonleaf_node_append_child(importDecl, ident);
+  AstNonLeafNode *importDecl = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_IMPORT_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, importDecl, ident);
   if (!match(parser, TOKEN_KIND_AS_KW))
   {
     consume(parser, TOKEN_KIND_SEMICOLON);
@@ -143,12 +408,11 @@ static inline AstNode *parse_import_decl(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  token = current(parser);
+  ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
-  AstNonLeafNode *rename = ast_nonleaf_node_new(AST_NODE_KIND_RENAME);
-  ast_nonleaf_node_append_child(rename, (AstNode *) importDecl);
-  ast_nonleaf_node_append_child(rename, ident);
+  AstNonLeafNode *rename = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_RENAME);
+  ast_nonleaf_node_append_child(&parser->arena, rename, (AstNode *) importDecl);
+  ast_nonleaf_node_append_child(&parser->arena, rename, ident);
   consume(parser, TOKEN_KIND_SEMICOLON);
   return (AstNode *) rename;
 }
@@ -158,17 +422,16 @@ static inline AstNode *parse_typealias_decl(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNonLeafNode *typealiasDecl = ast_nonleaf_node_new(AST_NODE_KIND_TYPEALIAS_DECL);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
+  AstNonLeafNode *typealiasDecl = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_TYPEALIAS_DECL);
   AstNode *polyParams = parse_poly_params(parser);
-  ast_nonleaf_node_append_child(typealiasDecl, ident);
-  ast_nonleaf_node_append_child(typealiasDecl, polyParams);
+  ast_nonleaf_node_append_child(&parser->arena, typealiasDecl, ident);
+  ast_nonleaf_node_append_child(&parser->arena, typealiasDecl, polyParams);
   consume(parser, TOKEN_KIND_EQ);
   AstNode *type = parse_type(parser);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  ast_nonleaf_node_append_child(typealiasDecl, type);
+  ast_nonleaf_node_append_child(&parser->arena, typealiasDecl, type);
   return (AstNode *) typealiasDecl;
 }
 
@@ -177,33 +440,32 @@ static inline AstNode *parse_poly_params(Parser *parser)
   if (!match(parser, TOKEN_KIND_LT))
     return NULL;
   next(parser);
-  AstNonLeafNode *polyParams = ast_nonleaf_node_new(AST_NODE_KIND_POLY_PARAMS);
+  int base = parser->scratchCount;
   AstNode *polyParam = parse_poly_param(parser);
-  ast_nonleaf_node_append_child(polyParams, polyParam);
+  push_node(parser, polyParam);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     polyParam = parse_poly_param(parser);
-    ast_nonleaf_node_append_child(polyParams, polyParam);
+    push_node(parser, polyParam);
   }
   consume(parser, TOKEN_KIND_GT);
-  return (AstNode *) polyParams;
+  return pop_nodes(parser, AST_NODE_KIND_POLY_PARAMS, base);
 }
 
 static inline AstNode *parse_poly_param(Parser *parser)
 {
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   if (!match(parser, TOKEN_KIND_COLON))
     return ident;
   next(parser);
   AstNode *type = parse_type(parser);
-  AstNonLeafNode *constraint = ast_nonleaf_node_new(AST_NODE_KIND_CONSTRAINT);
-  ast_nonleaf_node_append_child(constraint, ident);
-  ast_nonleaf_node_append_child(constraint, type);
+  AstNonLeafNode *constraint = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_CONSTRAINT);
+  ast_nonleaf_node_append_child(&parser->arena, constraint, ident);
+  ast_nonleaf_node_append_child(&parser->arena, constraint, type);
   return (AstNode *) constraint;
 }
 
@@ -220,29 +482,27 @@ static inline AstNode *parse_type(Parser *parser)
 static inline AstNode *parse_func_type(Parser *parser)
 {
   next(parser);
-  AstNode *type = parse_type(parser);
+  int base = parser->scratchCount;
+  push_node(parser, parse_type(parser));
   consume(parser, TOKEN_KIND_LPAREN);
-  AstNonLeafNode *params = ast_nonleaf_node_new(AST_NODE_KIND_PARAMS);
+  int paramsBase = parser->scratchCount;
   if (match(parser, TOKEN_KIND_RPAREN))
   {
     next(parser);
     goto end;
   }
   AstNode *param = parse_param_type(parser);
-  ast_nonleaf_node_append_child(params, param);
+  push_node(parser, param);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     param = parse_param_type(parser);
-    ast_nonleaf_node_append_child(params, param);
+    push_node(parser, param);
   }
   consume(parser, TOKEN_KIND_RPAREN);
-AstNonLeafNode *funcType;
 end:
-  funcType = ast_nonleaf_node_new(AST_NODE_KIND_FUNC_TYPE);
-  ast_nonleaf_node_append_child(funcType, type);
-  ast_nonleaf_node_append_child(funcType, (AstNode *) params);
-  return (AstNode *) funcType;
+  push_node(parser, pop_type_nodes(parser, AST_NODE_KIND_PARAMS, paramsBase));
+  return pop_type_nodes(parser, AST_NODE_KIND_FUNC_TYPE, base);
 }
 
 static inline AstNode *parse_param_type(Parser *parser)
@@ -250,39 +510,37 @@ static inline AstNode *parse_param_type(Parser *parser)
   if (match(parser, TOKEN_KIND_INOUT_KW))
   {
     next(parser);
-    AstNode *type = parse_type(parser);
-    AstNonLeafNode *inout = ast_nonleaf_node_new(AST_NODE_KIND_INOUT_PARAM);
-    ast_nonleaf_node_append_child(inout, type);
-    return (AstNode *) inout;
+    int base = parser->scratchCount;
+    push_node(parser, parse_type(parser));
+    return pop_type_nodes(parser, AST_NODE_KIND_INOUT_PARAM, base);
   }
   return parse_type(parser);
 }
 
 static inline AstNode *parse_type_def(Parser *parser)
 {
-  Token token = current(parser);
+  AstNode *ident = type_leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   if (!match(parser, TOKEN_KIND_LT))
-    return (AstNode *) ident;
+    return ident;
   next(parser);
-  AstNonLeafNode *typeDef = ast_nonleaf_node_new(AST_NODE_KIND_TYPE);
-  ast_nonleaf_node_append_child(typeDef, ident);
+  int base = parser->scratchCount;
+  push_node(parser, ident);
   if (match(parser, TOKEN_KIND_GT))
   {
     next(parser);
-    return (AstNode *) typeDef;
+    return pop_type_nodes(parser, AST_NODE_KIND_TYPE, base);
   }
   AstNode *type = parse_type(parser);
-  ast_nonleaf_node_append_child(typeDef, type);
+  push_node(parser, type);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     type = parse_type(parser);
-    ast_nonleaf_node_append_child(typeDef, type);
+    push_node(parser, type);
   }
   consume(parser, TOKEN_KIND_GT);
-  return (AstNode *) typeDef;
+  return pop_type_nodes(parser, AST_NODE_KIND_TYPE, base);
 }
 
 static inline AstNode *parse_func_decl(Parser *parser, bool isAnon)
@@ -290,39 +548,41 @@ static inline AstNode *parse_func_decl(Parser *parser, bool isAnon)
   next(parser);
   AstNode *type = parse_type(parser);
   AstNode *ident = NULL;
+  AstNode *params;
   if (!isAnon)
   {
     if (!match(parser, TOKEN_KIND_IDENT))
       unexpected_token_error(parser);
-    Token token = current(parser);
+    ident = leaf_node(parser, AST_NODE_KIND_IDENT);
     next(parser);
-    ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   }
   consume(parser, TOKEN_KIND_LPAREN);
-  AstNonLeafNode *params = ast_nonleaf_node_new(AST_NODE_KIND_PARAMS);
+  int base = parser->scratchCount;
   if (match(parser, TOKEN_KIND_RPAREN))
   {
     next(parser);
     goto end;
   }
   AstNode *param = parse_param(parser);
-  ast_nonleaf_node_append_child(params, param);
+  push_node(parser, param);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     param = parse_param(parser);
-    ast_nonleaf_node_append_child(params, param);
+    push_node(parser, param);
   }
   consume(parser, TOKEN_KIND_RPAREN);
 end:
+  params = pop_nodes(parser, AST_NODE_KIND_PARAMS, base);
   if (!match(parser, TOKEN_KIND_LBRACE))
     unexpected_token_error(parser);
-  AstNode *block = parse_block(parser);
-  AstNonLeafNode *funcDecl = ast_nonleaf_node_new(AST_NODE_KIND_FUNC_DECL);
-  ast_nonleaf_node_append_child(funcDecl, type);
-  ast_nonleaf_node_append_child(funcDecl, ident);
-  ast_nonleaf_node_append_child(funcDecl, (AstNode *) params);
-  ast_nonleaf_node_append_child(funcDecl, block);
+  AstNode *block = parser->flags & PARSER_FLAG_LAZY_BODIES ?
+    skip_block(parser) : parse_block(parser);
+  AstNonLeafNode *funcDecl = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_FUNC_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, funcDecl, type);
+  ast_nonleaf_node_append_child(&parser->arena, funcDecl, ident);
+  ast_nonleaf_node_append_child(&parser->arena, funcDecl, params);
+  ast_nonleaf_node_append_child(&parser->arena, funcDecl, block);
   return (AstNode *) funcDecl;
 }
 
@@ -331,26 +591,59 @@ static inline AstNode *parse_param(Parser *parser)
   AstNode *type = parse_param_type(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
-  AstNonLeafNode *param = ast_nonleaf_node_new(AST_NODE_KIND_VAR_DECL);
-  ast_nonleaf_node_append_child(param, type);
-  ast_nonleaf_node_append_child(param, ident);
+  AstNonLeafNode *param = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_VAR_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, param, type);
+  ast_nonleaf_node_append_child(&parser->arena, param, ident);
   return (AstNode *) param;
 }
 
 static inline AstNode *parse_block(Parser *parser)
 {
   next(parser);
-  AstNonLeafNode *block = ast_nonleaf_node_new(AST_NODE_KIND_BLOCK);
-  while (!match(parser, TOKEN_KIND_RBRACE))
+  int base = parser->scratchCount;
+  while (!match(parser, TOKEN_KIND_RBRACE) && !match(parser, TOKEN_KIND_EOF))
   {
-    AstNode *stmt = parse_stmt(parser);
-    ast_nonleaf_node_append_child(block, stmt);
+    AstNode *stmt = parse_recovering(parser, parse_stmt, true);
+    push_node(parser, stmt);
   }
+  consume(parser, TOKEN_KIND_RBRACE);
+  return pop_nodes(parser, AST_NODE_KIND_BLOCK, base);
+}
+
+static inline AstNode *skip_block(Parser *parser)
+{
+  // The body is left as the span from its '{' to its '}', to be parsed by
+  // parser_parse_body when it is needed.
+  Token token = parser->token;
+  if (parser->flags & PARSER_FLAG_PRETOKENIZE)
+  {
+    TokenStream *stream = &parser->stream;
+    int index = parser->index;
+    int depth = 0;
+    for (; index < stream->count - 1; ++index)
+    {
+      TokenKind kind = (TokenKind) stream->kinds[index];
+      if (kind == TOKEN_KIND_LBRACE)
+        ++depth;
+      else if (kind == TOKEN_KIND_RBRACE && !--depth)
+        break;
+    }
+    parser->index = index;
+    stream_token(parser);
+  }
+  else
+  {
+    lexer_skip_block(&parser->lex);
+    lexer_token(parser);
+  }
+  if (!match(parser, TOKEN_KIND_RBRACE))
+    unexpected_token_error(parser);
+  token.length = parser->token.offset + 1 - token.offset;
   next(parser);
-  return (AstNode *) block;
+  return (AstNode *) ast_leaf_node_new(&parser->arena,
+    AST_NODE_KIND_LAZY_BLOCK, token, (TokenValue) { 0 });
 }
 
 static inline AstNode *parse_struct_decl(Parser *parser)
@@ -358,28 +651,27 @@ static inline AstNode *parse_struct_decl(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNonLeafNode *structDecl = ast_nonleaf_node_new(AST_NODE_KIND_STRUCT_DECL);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   AstNode *polyParams = parse_poly_params(parser);
-  ast_nonleaf_node_append_child(structDecl, ident);
-  ast_nonleaf_node_append_child(structDecl, polyParams);
+  int base = parser->scratchCount;
+  push_node(parser, ident);
+  push_node(parser, polyParams);
   consume(parser, TOKEN_KIND_LBRACE);
   if (match(parser, TOKEN_KIND_RBRACE))
   {
     next(parser);
-    return (AstNode *) structDecl;
+    return pop_nodes(parser, AST_NODE_KIND_STRUCT_DECL, base);
   }
   AstNode *member = parse_struct_member(parser);
-  ast_nonleaf_node_append_child(structDecl, member);
+  push_node(parser, member);
   while (!match(parser, TOKEN_KIND_RBRACE))
   {
     member = parse_struct_member(parser);
-    ast_nonleaf_node_append_child(structDecl, member);
+    push_node(parser, member);
   }
   next(parser);
-  return (AstNode *) structDecl;
+  return pop_nodes(parser, AST_NODE_KIND_STRUCT_DECL, base);
 }
 
 static inline AstNode *parse_struct_member(Parser *parser)
@@ -388,17 +680,16 @@ static inline AstNode *parse_struct_member(Parser *parser)
   if (!match(parser, TOKEN_KIND_IDENT))
   {
     consume(parser, TOKEN_KIND_SEMICOLON);
-    AstNonLeafNode *member = ast_nonleaf_node_new(AST_NODE_KIND_TYPE);
-    ast_nonleaf_node_append_child(member, type);
+    AstNonLeafNode *member = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_TYPE);
+    ast_nonleaf_node_append_child(&parser->arena, member, type);
     return (AstNode *) member;
   }
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  AstNonLeafNode *member = ast_nonleaf_node_new(AST_NODE_KIND_VAR_DECL);
-  ast_nonleaf_node_append_child(member, type);
-  ast_nonleaf_node_append_child(member, ident);
+  AstNonLeafNode *member = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_VAR_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, member, type);
+  ast_nonleaf_node_append_child(&parser->arena, member, ident);
   return (AstNode *) member;
 }
 
@@ -407,66 +698,66 @@ static inline AstNode *parse_interface_decl(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNonLeafNode *interfaceDecl = ast_nonleaf_node_new(AST_NODE_KIND_INTERFACE_DECL);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   AstNode *polyParams = parse_poly_params(parser);
-  ast_nonleaf_node_append_child(interfaceDecl, ident);
-  ast_nonleaf_node_append_child(interfaceDecl, polyParams);
+  int base = parser->scratchCount;
+  push_node(parser, ident);
+  push_node(parser, polyParams);
   consume(parser, TOKEN_KIND_LBRACE);
   if (match(parser, TOKEN_KIND_RBRACE))
   {
     next(parser);
-    return (AstNode *) interfaceDecl;
+    return pop_nodes(parser, AST_NODE_KIND_INTERFACE_DECL, base);
   }
   AstNode *member = parse_interface_member(parser);
-  ast_nonleaf_node_append_child(interfaceDecl, member);
+  push_node(parser, member);
   while (!match(parser, TOKEN_KIND_RBRACE))
   {
     member = parse_interface_member(parser);
-    ast_nonleaf_node_append_child(interfaceDecl, member);
+    push_node(parser, member);
   }
   next(parser);
-  return (AstNode *) interfaceDecl;
+  return pop_nodes(parser, AST_NODE_KIND_INTERFACE_DECL, base);
 }
 
 static inline AstNode *parse_interface_member(Parser *parser)
 {
   AstNode *type = parse_type(parser);
+  AstNode *params;
   if (!match(parser, TOKEN_KIND_IDENT))
   {
     consume(parser, TOKEN_KIND_SEMICOLON);
-    AstNonLeafNode *member = ast_nonleaf_node_new(AST_NODE_KIND_TYPE);
-    ast_nonleaf_node_append_child(member, type);
+    AstNonLeafNode *member = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_TYPE);
+    ast_nonleaf_node_append_child(&parser->arena, member, type);
     return (AstNode *) member;
   }
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   consume(parser, TOKEN_KIND_LPAREN);
-  AstNonLeafNode *params = ast_nonleaf_node_new(AST_NODE_KIND_PARAMS);
+  int base = parser->scratchCount;
   if (match(parser, TOKEN_KIND_RPAREN))
   {
     next(parser);
     goto proto;
   }
   AstNode *param = parse_param(parser);
-  ast_nonleaf_node_append_child(params, param);
+  push_node(parser, param);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     param = parse_param(parser);
-    ast_nonleaf_node_append_child(params, param);
+    push_node(parser, param);
   }
   consume(parser, TOKEN_KIND_RPAREN);
 proto:
+  params = pop_nodes(parser, AST_NODE_KIND_PARAMS, base);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  AstNonLeafNode *member = ast_nonleaf_node_new(AST_NODE_KIND_FUNC_DECL);
-  ast_nonleaf_node_append_child(member, type);
-  ast_nonleaf_node_append_child(member, ident);
-  ast_nonleaf_node_append_child(member, (AstNode *) params);
-  ast_nonleaf_node_append_child(member, NULL);
+  AstNonLeafNode *member = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_FUNC_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, member, type);
+  ast_nonleaf_node_append_child(&parser->arena, member, ident);
+  ast_nonleaf_node_append_child(&parser->arena, member, params);
+  ast_nonleaf_node_append_child(&parser->arena, member, NULL);
   return (AstNode *) member;
 }
 
@@ -475,15 +766,14 @@ static inline AstNode *parse_const_decl(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   consume(parser, TOKEN_KIND_EQ);
   AstNode *expr = parse_expr(parser);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  AstNonLeafNode *constDecl = ast_nonleaf_node_new(AST_NODE_KIND_CONST_DECL);
-  ast_nonleaf_node_append_child(constDecl, ident);
-  ast_nonleaf_node_append_child(constDecl, expr);
+  AstNonLeafNode *constDecl = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_CONST_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, constDecl, ident);
+  ast_nonleaf_node_append_child(&parser->arena, constDecl, expr);
   return (AstNode *) constDecl;
 }
 
@@ -493,9 +783,8 @@ static inline AstNode *parse_var_decl(Parser *parser)
   AstNode *type = parse_type(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   AstNode *expr = NULL;
   if (match(parser, TOKEN_KIND_EQ))
   {
@@ -503,10 +792,10 @@ static inline AstNode *parse_var_decl(Parser *parser)
     expr = parse_expr(parser);
   }
   consume(parser, TOKEN_KIND_SEMICOLON);
-  AstNonLeafNode *varDecl = ast_nonleaf_node_new(AST_NODE_KIND_VAR_DECL);
-  ast_nonleaf_node_append_child(varDecl, type);
-  ast_nonleaf_node_append_child(varDecl, ident);
-  ast_nonleaf_node_append_child(varDecl, expr);
+  AstNonLeafNode *varDecl = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_VAR_DECL);
+  ast_nonleaf_node_append_child(&parser->arena, varDecl, type);
+  ast_nonleaf_node_append_child(&parser->arena, varDecl, ident);
+  ast_nonleaf_node_append_child(&parser->arena, varDecl, expr);
   return (AstNode *) varDecl;
 }
 
@@ -562,10 +851,10 @@ static inline AstNode *parse_if_stmt(Parser *parser)
       unexpected_token_error(parser);
     elseBlock = parse_block(parser);
   }
-  AstNonLeafNode *ifStmt = ast_nonleaf_node_new(AST_NODE_KIND_IF);
-  ast_nonleaf_node_append_child(ifStmt, expr);
-  ast_nonleaf_node_append_child(ifStmt, thenBlock);
-  ast_nonleaf_node_append_child(ifStmt, elseBlock);
+  AstNonLeafNode *ifStmt = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_IF);
+  ast_nonleaf_node_append_child(&parser->arena, ifStmt, expr);
+  ast_nonleaf_node_append_child(&parser->arena, ifStmt, thenBlock);
+  ast_nonleaf_node_append_child(&parser->arena, ifStmt, elseBlock);
   return (AstNode *) ifStmt;
 }
 
@@ -574,39 +863,42 @@ static inline AstNode *parse_switch_stmt(Parser *parser)
   next(parser);
   AstNode *expr = parse_expr(parser);
   consume(parser, TOKEN_KIND_LBRACE);
-  AstNonLeafNode *switchStmt = ast_nonleaf_node_new(AST_NODE_KIND_SWITCH);
-  ast_nonleaf_node_append_child(switchStmt, expr);
+  int base = parser->scratchCount;
+  push_node(parser, expr);
   while (match(parser, TOKEN_KIND_CASE_KW))
   {
     next(parser);
     expr = parse_expr(parser);
     consume(parser, TOKEN_KIND_COLON);
-    AstNonLeafNode *switchCase = ast_nonleaf_node_new(AST_NODE_KIND_CASE);
-    ast_nonleaf_node_append_child(switchCase, expr);
+    int caseBase = parser->scratchCount;
+    push_node(parser, expr);
     while (!match(parser, TOKEN_KIND_CASE_KW)
         && !match(parser, TOKEN_KIND_DEFAULT_KW)
-        && !match(parser, TOKEN_KIND_RBRACE))
+        && !match(parser, TOKEN_KIND_RBRACE)
+        && !match(parser, TOKEN_KIND_EOF))
     {
-      AstNode *stmt = parse_stmt(parser);
-      ast_nonleaf_node_append_child(switchCase, stmt);
+      AstNode *stmt = parse_recovering(parser, parse_stmt, true);
+      push_node(parser, stmt);
     }
-    ast_nonleaf_node_append_child(switchStmt, (AstNode *) switchCase);
+    AstNode *switchCase = pop_nodes(parser, AST_NODE_KIND_CASE, caseBase);
+    push_node(parser, switchCase);
   }
-  AstNonLeafNode *switchDefault = NULL;
+  AstNode *switchDefault = NULL;
   if (match(parser, TOKEN_KIND_DEFAULT_KW))
   {
     next(parser);
     consume(parser, TOKEN_KIND_COLON);
-    switchDefault = ast_nonleaf_node_new(AST_NODE_KIND_DEFAULT);
-    while (!match(parser, TOKEN_KIND_RBRACE))
+    int defaultBase = parser->scratchCount;
+    while (!match(parser, TOKEN_KIND_RBRACE) && !match(parser, TOKEN_KIND_EOF))
     {
-      AstNode *stmt = parse_stmt(parser);
-      ast_nonleaf_node_append_child(switchDefault, stmt);
+      AstNode *stmt = parse_recovering(parser, parse_stmt, true);
+      push_node(parser, stmt);
     }
+    switchDefault = pop_nodes(parser, AST_NODE_KIND_DEFAULT, defaultBase);
   }
-  ast_nonleaf_node_append_child(switchStmt, (AstNode *) switchDefault);
+  push_node(parser, switchDefault);
   consume(parser, TOKEN_KIND_RBRACE);
-  return (AstNode *) switchStmt;
+  return pop_nodes(parser, AST_NODE_KIND_SWITCH, base);
 }
 
 static inline AstNode *parse_while_stmt(Parser *parser)
@@ -616,9 +908,9 @@ static inline AstNode *parse_while_stmt(Parser *parser)
   if (!match(parser, TOKEN_KIND_LBRACE))
     unexpected_token_error(parser);
   AstNode *block = parse_block(parser);
-  AstNonLeafNode *whileStmt = ast_nonleaf_node_new(AST_NODE_KIND_WHILE);
-  ast_nonleaf_node_append_child(whileStmt, expr);
-  ast_nonleaf_node_append_child(whileStmt, block);
+  AstNonLeafNode *whileStmt = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_WHILE);
+  ast_nonleaf_node_append_child(&parser->arena, whileStmt, expr);
+  ast_nonleaf_node_append_child(&parser->arena, whileStmt, block);
   return (AstNode *) whileStmt;
 }
 
@@ -631,9 +923,9 @@ static inline AstNode *parse_do_while_stmt(Parser *parser)
   consume(parser, TOKEN_KIND_WHILE_KW);
   AstNode *expr = parse_expr(parser);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  AstNonLeafNode *doWhileStmt = ast_nonleaf_node_new(AST_NODE_KIND_DO_WHILE);
-  ast_nonleaf_node_append_child(doWhileStmt, block);
-  ast_nonleaf_node_append_child(doWhileStmt, expr);
+  AstNonLeafNode *doWhileStmt = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_DO_WHILE);
+  ast_nonleaf_node_append_child(&parser->arena, doWhileStmt, block);
+  ast_nonleaf_node_append_child(&parser->arena, doWhileStmt, expr);
   return (AstNode *) doWhileStmt;
 }
 
@@ -642,41 +934,40 @@ static inline AstNode *parse_for_stmt(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   consume(parser, TOKEN_KIND_IN_KW);
   AstNode *expr = parse_expr(parser);
   if (!match(parser, TOKEN_KIND_LBRACE))
     unexpected_token_error(parser);
   AstNode *block = parse_block(parser);
-  AstNonLeafNode *forStmt = ast_nonleaf_node_new(AST_NODE_KIND_FOR);
-  ast_nonleaf_node_append_child(forStmt, ident);
-  ast_nonleaf_node_append_child(forStmt, expr);
-  ast_nonleaf_node_append_child(forStmt, block);
+  AstNonLeafNode *forStmt = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_FOR);
+  ast_nonleaf_node_append_child(&parser->arena, forStmt, ident);
+  ast_nonleaf_node_append_child(&parser->arena, forStmt, expr);
+  ast_nonleaf_node_append_child(&parser->arena, forStmt, block);
   return (AstNode *) forStmt;
 }
 
 static inline AstNode *parse_break_stmt(Parser *parser)
 {
-  Token token = current(parser);
+  AstNode *node = leaf_node(parser, AST_NODE_KIND_BREAK);
   next(parser);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_BREAK, token);
+  return node;
 }
 
 static inline AstNode *parse_continue_stmt(Parser *parser)
 {
-  Token token = current(parser);
+  AstNode *node = leaf_node(parser, AST_NODE_KIND_CONTINUE);
   next(parser);
   consume(parser, TOKEN_KIND_SEMICOLON);
-  return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_CONTINUE, token);
+  return node;
 }
 
 static inline AstNode *parse_return_stmt(Parser *parser)
 {
   next(parser);
-  AstNonLeafNode *retStmt = ast_nonleaf_node_new(AST_NODE_KIND_RETURN);
+  AstNonLeafNode *retStmt = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_RETURN);
   AstNode *expr = NULL;
   if (match(parser, TOKEN_KIND_SEMICOLON))
   {
@@ -686,431 +977,100 @@ static inline AstNode *parse_return_stmt(Parser *parser)
   expr = parse_expr(parser);
   consume(parser, TOKEN_KIND_SEMICOLON);
 end:
-  ast_nonleaf_node_append_child(retStmt, expr);
+  ast_nonleaf_node_append_child(&parser->arena, retStmt, expr);
   return (AstNode *) retStmt;
 }
 
 static inline AstNode *parse_expr(Parser *parser)
 {
-  AstNode *lhs = parse_or_expr(parser);
-  AstNodeKind kind = AST_NODE_KIND_ASSIGN;
-  if (match(parser, TOKEN_KIND_EQ))
-  {
-    next(parser);
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_PIPEEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_BOR_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_CARETEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_BXOR_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_AMPEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_BAND_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_LTLTEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_SHL_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_GTGTEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_SHR_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_PLUSEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_ADD_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_MINUSEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_SUB_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_STAREQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_MUL_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_SLASHEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_DIV_ASSIGN;
-    goto end;
-  }
-  if (match(parser, TOKEN_KIND_PERCENTEQ))
-  {
-    next(parser);
-    kind = AST_NODE_KIND_MOD_ASSIGN;
-    goto end;
-  }
-  return lhs;
-  AstNode *rhs;
-end:
-  rhs = parse_expr(parser);
-  AstNonLeafNode *assign = ast_nonleaf_node_new(kind);
-  ast_nonleaf_node_append_child(assign, lhs);
-  ast_nonleaf_node_append_child(assign, rhs);
-  return (AstNode *) assign;
-}
-
-static inline AstNode *parse_or_expr(Parser *parser)
-{
-  AstNode *lhs = parse_and_expr(parser);
-  while (match(parser, TOKEN_KIND_PIPEPIPE))
-  {
-    next(parser);
-    AstNode *rhs = parse_and_expr(parser);
-    AstNonLeafNode *or = ast_nonleaf_node_new(AST_NODE_KIND_OR);
-    ast_nonleaf_node_append_child(or, lhs);
-    ast_nonleaf_node_append_child(or, rhs);
-    lhs = (AstNode *) or;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_and_expr(Parser *parser)
-{
-  AstNode *lhs = parse_bor_expr(parser);
-  while (match(parser, TOKEN_KIND_AMPAMP))
-  {
-    next(parser);
-    AstNode *rhs = parse_bor_expr(parser);
-    AstNonLeafNode *and = ast_nonleaf_node_new(AST_NODE_KIND_AND);
-    ast_nonleaf_node_append_child(and, lhs);
-    ast_nonleaf_node_append_child(and, rhs);
-    lhs = (AstNode *) and;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_bor_expr(Parser *parser)
-{
-  AstNode *lhs = parse_bxor_expr(parser);
-  while (match(parser, TOKEN_KIND_PIPE))
-  {
-    next(parser);
-    AstNode *rhs = parse_bxor_expr(parser);
-    AstNonLeafNode *bor = ast_nonleaf_node_new(AST_NODE_KIND_BOR);
-    ast_nonleaf_node_append_child(bor, lhs);
-    ast_nonleaf_node_append_child(bor, rhs);
-    lhs = (AstNode *) bor;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_bxor_expr(Parser *parser)
-{
-  AstNode *lhs = parse_band_expr(parser);
-  while (match(parser, TOKEN_KIND_CARET))
-  {
-    next(parser);
-    AstNode *rhs = parse_band_expr(parser);
-    AstNonLeafNode *bxor = ast_nonleaf_node_new(AST_NODE_KIND_BXOR);
-    ast_nonleaf_node_append_child(bxor, lhs);
-    ast_nonleaf_node_append_child(bxor, rhs);
-    lhs = (AstNode *) bxor;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_band_expr(Parser *parser)
-{
-  AstNode *lhs = parse_eq_expr(parser);
-  while (match(parser, TOKEN_KIND_AMP))
-  {
-    next(parser);
-    AstNode *rhs = parse_eq_expr(parser);
-    AstNonLeafNode *band = ast_nonleaf_node_new(AST_NODE_KIND_BAND);
-    ast_nonleaf_node_append_child(band, lhs);
-    ast_nonleaf_node_append_child(band, rhs);
-    lhs = (AstNode *) band;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_eq_expr(Parser *parser)
-{
-  AstNode *lhs = parse_comp_expr(parser);
-  for (;;)
-  {
-    if (match(parser, TOKEN_KIND_EQEQ))
-    {
-      next(parser);
-      AstNode *rhs = parse_comp_expr(parser);
-      AstNonLeafNode *eq = ast_nonleaf_node_new(AST_NODE_KIND_EQ);
-      ast_nonleaf_node_append_child(eq, lhs);
-      ast_nonleaf_node_append_child(eq, rhs);
-      lhs = (AstNode *) eq;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_BANGEQ))
-    {
-      next(parser);
-      AstNode *rhs = parse_comp_expr(parser);
-      AstNonLeafNode *ne = ast_nonleaf_node_new(AST_NODE_KIND_NE);
-      ast_nonleaf_node_append_child(ne, lhs);
-      ast_nonleaf_node_append_child(ne, rhs);
-      lhs = (AstNode *) ne;
-      continue;
-    }
-    break;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_comp_expr(Parser *parser)
-{
-  AstNode *lhs = parse_shift_expr(parser);
-  for (;;)
-  {
-    if (match(parser, TOKEN_KIND_LT))
-    {
-      next(parser);
-      AstNode *rhs = parse_shift_expr(parser);
-      AstNonLeafNode *lt = ast_nonleaf_node_new(AST_NODE_KIND_LT);
-      ast_nonleaf_node_append_child(lt, lhs);
-      ast_nonleaf_node_append_child(lt, rhs);
-      lhs = (AstNode *) lt;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_LE))
-    {
-      next(parser);
-      AstNode *rhs = parse_shift_expr(parser);
-      AstNonLeafNode *le = ast_nonleaf_node_new(AST_NODE_KIND_LE);
-      ast_nonleaf_node_append_child(le, lhs);
-      ast_nonleaf_node_append_child(le, rhs);
-      lhs = (AstNode *) le;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_GT))
-    {
-      next(parser);
-      AstNode *rhs = parse_shift_expr(parser);
-      AstNonLeafNode *gt = ast_nonleaf_node_new(AST_NODE_KIND_GT);
-      ast_nonleaf_node_append_child(gt, lhs);
-      ast_nonleaf_node_append_child(gt, rhs);
-      lhs = (AstNode *) gt;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_GE))
-    {
-      next(parser);
-      AstNode *rhs = parse_shift_expr(parser);
-      AstNonLeafNode *ge = ast_nonleaf_node_new(AST_NODE_KIND_GE);
-      ast_nonleaf_node_append_child(ge, lhs);
-      ast_nonleaf_node_append_child(ge, rhs);
-      lhs = (AstNode *) ge;
-      continue;
-    }
-    break;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_shift_expr(Parser *parser)
-{
-  AstNode *lhs = parse_range_expr(parser);
-  for (;;)
-  {
-    if (match(parser, TOKEN_KIND_LTLT))
-    {
-      next(parser);
-      AstNode *rhs = parse_range_expr(parser);
-      AstNonLeafNode *shl = ast_nonleaf_node_new(AST_NODE_KIND_SHL);
-      ast_nonleaf_node_append_child(shl, lhs);
-      ast_nonleaf_node_append_child(shl, rhs);
-      lhs = (AstNode *) shl;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_GTGT))
-    {
-      next(parser);
-      AstNode *rhs = parse_range_expr(parser);
-      AstNonLeafNode *shr = ast_nonleaf_node_new(AST_NODE_KIND_SHR);
-      ast_nonleaf_node_append_child(shr, lhs);
-      ast_nonleaf_node_append_child(shr, rhs);
-      lhs = (AstNode *) shr;
-      continue;
-    }
-    break;
-  }
-  return lhs;
-}
-
-static inline AstNode *parse_range_expr(Parser *parser)
-{
-  AstNode *lhs = parse_add_expr(parser);
-  if (match(parser, TOKEN_KIND_DOTDOT))
-  {
-    next(parser);
-    AstNode *rhs = parse_add_expr(parser);
-    AstNonLeafNode *range = ast_nonleaf_node_new(AST_NODE_KIND_RANGE);
-    ast_nonleaf_node_append_child(range, lhs);
-    ast_nonleaf_node_append_child(range, rhs);
-    return (AstNode *) range;
-  }
-  return lhs;
+  AstNode *lhs = parse_binary_expr(parser, PREC_OR);
+  const Operator *op = &assignOps[parser->kind];
+  if (op->prec == PREC_NONE)
+    return lhs;
+  next(parser);
+  AstNode *rhs = parse_expr(parser);
+  return binary_node(parser, op->kind, lhs, rhs);
 }
 
-static inline AstNode *parse_add_expr(Parser *parser)
+static inline AstNode *binary_node(Parser *parser, AstNodeKind kind,
+  AstNode *lhs, AstNode *rhs)
 {
-  AstNode *lhs = parse_mul_expr(parser);
-  for (;;)
-  {
-    if (match(parser, TOKEN_KIND_PLUS))
-    {
-      next(parser);
-      AstNode *rhs = parse_mul_expr(parser);
-      AstNonLeafNode *add = ast_nonleaf_node_new(AST_NODE_KIND_ADD);
-      ast_nonleaf_node_append_child(add, lhs);
-      ast_nonleaf_node_append_child(add, rhs);
-      lhs = (AstNode *) add;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_MINUS))
-    {
-      next(parser);
-      AstNode *rhs = parse_mul_expr(parser);
-      AstNonLeafNode *sub = ast_nonleaf_node_new(AST_NODE_KIND_SUB);
-      ast_nonleaf_node_append_child(sub, lhs);
-      ast_nonleaf_node_append_child(sub, rhs);
-      lhs = (AstNode *) sub;
-      continue;
-    }
-    break;
-  }
-  return lhs;
+  AstNode *children[] = { lhs, rhs };
+  return (AstNode *) ast_nonleaf_node_new_with_children(&parser->arena, kind,
+    2, children);
 }
 
-static inline AstNode *parse_mul_expr(Parser *parser)
+static inline AstNode *parse_binary_expr(Parser *parser, Precedence minPrec)
 {
   AstNode *lhs = parse_unary_expr(parser);
   for (;;)
   {
-    if (match(parser, TOKEN_KIND_STAR))
-    {
-      next(parser);
-      AstNode *rhs = parse_unary_expr(parser);
-      AstNonLeafNode *mul = ast_nonleaf_node_new(AST_NODE_KIND_MUL);
-      ast_nonleaf_node_append_child(mul, lhs);
-      ast_nonleaf_node_append_child(mul, rhs);
-      lhs = (AstNode *) mul;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_SLASH))
-    {
-      next(parser);
-      AstNode *rhs = parse_unary_expr(parser);
-      AstNonLeafNode *div = ast_nonleaf_node_new(AST_NODE_KIND_DIV);
-      ast_nonleaf_node_append_child(div, lhs);
-      ast_nonleaf_node_append_child(div, rhs);
-      lhs = (AstNode *) div;
-      continue;
-    }
-    if (match(parser, TOKEN_KIND_PERCENT))
-    {
-      next(parser);
-      AstNode *rhs = parse_unary_expr(parser);
-      AstNonLeafNode *mod = ast_nonleaf_node_new(AST_NODE_KIND_MOD);
-      ast_nonleaf_node_append_child(mod, lhs);
-      ast_nonleaf_node_append_child(mod, rhs);
-      lhs = (AstNode *) mod;
-      continue;
-    }
-    break;
+    const Operator *op = &binaryOps[parser->kind];
+    if (op->prec == PREC_NONE || op->prec < minPrec)
+      return lhs;
+    next(parser);
+    AstNode *rhs = parse_binary_expr(parser, op->prec + 1);
+    lhs = binary_node(parser, op->kind, lhs, rhs);
+    // No operator of any level accepts a range followed by another one.
+    if (op->prec == PREC_RANGE && match(parser, TOKEN_KIND_DOTDOT))
+      unexpected_token_error(parser);
   }
-  return lhs;
 }
 
 static inline AstNode *parse_unary_expr(Parser *parser)
 {
-  if (match(parser, TOKEN_KIND_BANG))
-  {
-    next(parser);
-    AstNode *expr = parse_unary_expr(parser);
-    AstNonLeafNode *not = ast_nonleaf_node_new(AST_NODE_KIND_NOT);
-    ast_nonleaf_node_append_child(not, expr);
-    return (AstNode *) not;
-  }
-  if (match(parser, TOKEN_KIND_MINUS))
-  {
-    next(parser);
-    AstNode *expr = parse_unary_expr(parser);
-    AstNonLeafNode *neg = ast_nonleaf_node_new(AST_NODE_KIND_NEG);
-    ast_nonleaf_node_append_child(neg, expr);
-    return (AstNode *) neg;
-  }
-  if (match(parser, TOKEN_KIND_TILDE))
-  {
-    next(parser);
-    AstNode *expr = parse_unary_expr(parser);
-    AstNonLeafNode *bnot = ast_nonleaf_node_new(AST_NODE_KIND_BNOT);
-    ast_nonleaf_node_append_child(bnot, expr);
-    return (AstNode *) bnot;
-  }
-  return parse_prim_expr(parser);
+  const Operator *op = &unaryOps[parser->kind];
+  if (op->prec == PREC_NONE)
+    return parse_prim_expr(parser);
+  next(parser);
+  AstNode *expr = parse_unary_expr(parser);
+  return (AstNode *) ast_nonleaf_node_new_with_children(&parser->arena,
+    op->kind, 1, &expr);
 }
 
 static inline AstNode *parse_prim_expr(Parser *parser)
 {
   if (match(parser, TOKEN_KIND_VOID_KW))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_VOID);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_VOID, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_FALSE_KW))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_FALSE);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_FALSE, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_TRUE_KW))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_TRUE);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_TRUE, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_INT))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_INT);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_INT, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_FLOAT))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_FLOAT);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_FLOAT, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_CHAR))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_CHAR);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_CHAR, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_STRING))
   {
-    Token token = current(parser);
+    AstNode *node = leaf_node(parser, AST_NODE_KIND_STRING);
     next(parser);
-    return (AstNode *) ast_leaf_node_new(AST_NODE_KIND_STRING, token);
+    return node;
   }
   if (match(parser, TOKEN_KIND_LBRACKET))
     return parse_array_expr(parser);
@@ -1140,44 +1100,44 @@ static inline AstNode *parse_prim_expr(Parser *parser)
 static inline AstNode *parse_array_expr(Parser *parser)
 {
   next(parser);
-  AstNonLeafNode *array = ast_nonleaf_node_new(AST_NODE_KIND_ARRAY);
+  int base = parser->scratchCount;
   if (!match(parser, TOKEN_KIND_RBRACKET))
   {
     AstNode *expr = parse_expr(parser);
-    ast_nonleaf_node_append_child(array, expr);
+    push_node(parser, expr);
     while (match(parser, TOKEN_KIND_COMMA))
     {
       next(parser);
       expr = parse_expr(parser);
-      ast_nonleaf_node_append_child(array, expr);
+      push_node(parser, expr);
     }
   }
   consume(parser, TOKEN_KIND_RBRACKET);
-  return (AstNode *) array;
+  return pop_nodes(parser, AST_NODE_KIND_ARRAY, base);
 }
 
 static inline AstNode *parse_new_expr(Parser *parser)
 {
   next(parser);
   AstNode *type = parse_type(parser);
-  AstNonLeafNode *newExpr = ast_nonleaf_node_new(AST_NODE_KIND_NEW);
-  ast_nonleaf_node_append_child(newExpr, type);
+  int base = parser->scratchCount;
+  push_node(parser, type);
   consume(parser, TOKEN_KIND_LPAREN);
   if (match(parser, TOKEN_KIND_RPAREN))
   {
     next(parser);
-    return (AstNode *) newExpr;
+    return pop_nodes(parser, AST_NODE_KIND_NEW, base);
   }
   AstNode *expr = parse_expr(parser);
-  ast_nonleaf_node_append_child(newExpr, expr);
+  push_node(parser, expr);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     expr = parse_expr(parser);
-    ast_nonleaf_node_append_child(newExpr, expr);
+    push_node(parser, expr);
   }
   consume(parser, TOKEN_KIND_RPAREN);
-  return (AstNode *) newExpr;
+  return pop_nodes(parser, AST_NODE_KIND_NEW, base);
 }
 
 static inline AstNode *parse_ref_expr(Parser *parser)
@@ -1185,25 +1145,23 @@ static inline AstNode *parse_ref_expr(Parser *parser)
   next(parser);
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
-  Token token = current(parser);
+  AstNode *lhs = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *lhs = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
-  AstNonLeafNode *ref = ast_nonleaf_node_new(AST_NODE_KIND_REF);
+  AstNonLeafNode *ref = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_REF);
   AstNode *subscr = parse_subscr(parser, lhs);
   while (subscr)
   {
     lhs = subscr;
     subscr = parse_subscr(parser, lhs);
   }
-  ast_nonleaf_node_append_child(ref, lhs);
+  ast_nonleaf_node_append_child(&parser->arena, ref, lhs);
   return (AstNode *) ref;
 }
 
 static inline AstNode *parse_ident_expr(Parser *parser)
 {
-  Token token = current(parser);
+  AstNode *lhs = leaf_node(parser, AST_NODE_KIND_IDENT);
   next(parser);
-  AstNode *lhs = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
   for (;;)
   {
     AstNode *subscr = parse_subscr(parser, lhs);
@@ -1229,8 +1187,8 @@ static inline AstNode *parse_try_expr(Parser *parser)
   if (!match(parser, TOKEN_KIND_IDENT))
     unexpected_token_error(parser);
   AstNode *expr = parse_expr(parser);
-  AstNonLeafNode *tryExpr = ast_nonleaf_node_new(AST_NODE_KIND_TRY);
-  ast_nonleaf_node_append_child(tryExpr, expr);
+  AstNonLeafNode *tryExpr = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_TRY);
+  ast_nonleaf_node_append_child(&parser->arena, tryExpr, expr);
   return (AstNode *) tryExpr;
 }
 
@@ -1239,23 +1197,23 @@ static inline AstNode *parse_call(Parser *parser, AstNode *lhs)
   if (!match(parser, TOKEN_KIND_LPAREN))
     return NULL;
   next(parser);
-  AstNonLeafNode *call = ast_nonleaf_node_new(AST_NODE_KIND_CALL);
-  ast_nonleaf_node_append_child(call, lhs);
+  int base = parser->scratchCount;
+  push_node(parser, lhs);
   if (match(parser, TOKEN_KIND_RPAREN))
   {
     next(parser);
-    return (AstNode *) call;
+    return pop_nodes(parser, AST_NODE_KIND_CALL, base);
   }
   AstNode *expr = parse_expr(parser);
-  ast_nonleaf_node_append_child(call, expr);
+  push_node(parser, expr);
   while (match(parser, TOKEN_KIND_COMMA))
   {
     next(parser);
     expr = parse_expr(parser);
-    ast_nonleaf_node_append_child(call, expr);
+    push_node(parser, expr);
   }
   consume(parser, TOKEN_KIND_RPAREN);
-  return (AstNode *) call;
+  return pop_nodes(parser, AST_NODE_KIND_CALL, base);
 }
 
 static inline AstNode *parse_subscr(Parser *parser, AstNode *lhs)
@@ -1265,9 +1223,9 @@ static inline AstNode *parse_subscr(Parser *parser, AstNode *lhs)
     next(parser);
     AstNode *expr = parse_expr(parser);
     consume(parser, TOKEN_KIND_RBRACKET);
-    AstNonLeafNode *subscr = ast_nonleaf_node_new(AST_NODE_KIND_ELEMENT);
-    ast_nonleaf_node_append_child(subscr, lhs);
-    ast_nonleaf_node_append_child(subscr, expr);
+    AstNonLeafNode *subscr = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_ELEMENT);
+    ast_nonleaf_node_append_child(&parser->arena, subscr, lhs);
+    ast_nonleaf_node_append_child(&parser->arena, subscr, expr);
     return (AstNode *) subscr;
   }
   if (match(parser, TOKEN_KIND_DOT))
@@ -1275,12 +1233,11 @@ static inline AstNode *parse_subscr(Parser *parser, AstNode *lhs)
     next(parser);
     if (!match(parser, TOKEN_KIND_IDENT))
       unexpected_token_error(parser);
-    Token token = current(parser);
+    AstNode *ident = leaf_node(parser, AST_NODE_KIND_IDENT);
     next(parser);
-    AstNode *ident = (AstNode *) ast_leaf_node_new(AST_NODE_KIND_IDENT, token);
-    AstNonLeafNode *subscr = ast_nonleaf_node_new(AST_NODE_KIND_FIELD);
-    ast_nonleaf_node_append_child(subscr, lhs);
-    ast_nonleaf_node_append_child(subscr, ident);
+    AstNonLeafNode *subscr = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_FIELD);
+    ast_nonleaf_node_append_child(&parser->arena, subscr, lhs);
+    ast_nonleaf_node_append_child(&parser->arena, subscr, ident);
     return (AstNode *) subscr;
   }
   return NULL;
@@ -1297,19 +1254,79 @@ static inline AstNode *parse_if_expr(Parser *parser)
   consume(parser, TOKEN_KIND_LBRACE);
   AstNode *elseExpr = parse_expr(parser);
   consume(parser, TOKEN_KIND_RBRACE);
-  AstNonLeafNode *ifExpr = ast_nonleaf_node_new(AST_NODE_KIND_IF);
-  ast_nonleaf_node_append_child(ifExpr, expr);
-  ast_nonleaf_node_append_child(ifExpr, thenExpr);
-  ast_nonleaf_node_append_child(ifExpr, elseExpr);
+  AstNonLeafNode *ifExpr = ast_nonleaf_node_new(&parser->arena, AST_NODE_KIND_IF);
+  ast_nonleaf_node_append_child(&parser->arena, ifExpr, expr);
+  ast_nonleaf_node_append_child(&parser->arena, ifExpr, thenExpr);
+  ast_nonleaf_node_append_child(&parser->arena, ifExpr, elseExpr);
   return (AstNode *) ifExpr;
 }
 
-void parser_init(Parser *parser, char *file, char *source)
+void parser_init(Parser *parser, char *file, char *source, Interner *interner,
+  int flags)
 {
-  lexer_init(&parser->lex, file, source);
+  parser->flags = flags;
+  arena_init(&parser->arena);
+  scratch_init(parser);
+  type_table_init(&parser->types);
+  diag_init(&parser->diags);
+  parser->recover = NULL;
+  lexer_init(&parser->lex, file, source, interner, &parser->diags);
+  if (flags & PARSER_FLAG_PRETOKENIZE)
+  {
+    lexer_tokenize(&parser->lex, &parser->stream);
+    parser->index = 0;
+    stream_token(parser);
+    return;
+  }
+  lexer_token(parser);
+}
+
+void parser_init_reader(Parser *parser, char *file, LexerRead read,
+  void *data, Interner *interner)
+{
+  parser->flags = 0;
+  arena_init(&parser->arena);
+  scratch_init(parser);
+  type_table_init(&parser->types);
+  diag_init(&parser->diags);
+  parser->recover = NULL;
+  lexer_init_reader(&parser->lex, file, read, data, interner, &parser->diags);
+  lexer_token(parser);
+}
+
+void parser_deinit(Parser *parser)
+{
+  // Releases the whole tree at once.
+  arena_deinit(&parser->arena);
+  free(parser->scratch);
+  type_table_deinit(&parser->types);
+  diag_deinit(&parser->diags);
+  lexer_deinit(&parser->lex);
+  if (parser->flags & PARSER_FLAG_PRETOKENIZE)
+  {
+    free(parser->stream.kinds);
+    free(parser->stream.tokens);
+    free(parser->stream.values);
+  }
 }
 
 AstNode *parser_parse(Parser *parser)
 {
+  // Syntax errors are collected in diags and leave error nodes in the tree.
   return parse_module(parser);
 }
+
+AstNode *parser_parse_body(Parser *parser, AstNode *funcDecl)
+{
+  // Parses a body left unparsed by PARSER_FLAG_LAZY_BODIES the first time
+  // it is requested, and puts it in place of its span in the tree. The
+  // body of an interface member is null.
+  AstNonLeafNode *node = (AstNonLeafNode *) funcDecl;
+  AstNode *body = node->children[3];
+  if (!body || body->kind != AST_NODE_KIND_LAZY_BLOCK)
+    return body;
+  seek_token(parser, ((AstLeafNode *) body)->token.offset);
+  body = parse_recovering(parser, parse_block, true);
+  node->children[3] = body;
+  return body;
+}
@@ -11,14 +11,40 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <setjmp.h>
 #include "ast.h"
+#include "diag.h"
+#include "types.h"
+
+#define PARSER_FLAG_PRETOKENIZE 0x01
+#define PARSER_FLAG_LAZY_BODIES 0x02
+
+#define PARSER_SCRATCH_MIN_CAPACITY (1 << 8)
 
 typedef struct
 {
-  Lexer lex;
+  int         flags;
+  Arena       arena;
+  int         scratchCapacity;
+  int         scratchCount;
+  AstNode     **scratch;
+  TypeTable   types;
+  DiagList    diags;
+  jmp_buf     *recover;
+  Lexer       lex;
+  TokenStream stream;
+  int         index;
+  TokenKind   kind;
+  Token       token;
+  TokenValue  value;
 } Parser;
 
-void parser_init(Parser *parser, char *file, char *source);
+void parser_init(Parser *parser, char *file, char *source, Interner *interner,
+  int flags);
+void parser_init_reader(Parser *parser, char *file, LexerRead read,
+  void *data, Interner *interner);
+void parser_deinit(Parser *parser);
 AstNode *parser_parse(Parser *parser);
+AstNode *parser_parse_body(Parser *parser, AstNode *funcDecl);
 
 #endif // PARSER_H
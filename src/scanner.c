@@ -0,0 +1,430 @@
+//
+// scanner.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "scanner.h"
+#include <stdbool.h>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define SCANNER_SSE2
+  #include <emmintrin.h>
+#endif
+
+#if defined(SCANNER_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+  #define SCANNER_AVX2
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#endif
+
+#if defined(__GNUC__)
+  #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define TARGET_AVX2
+#endif
+
+static inline bool is_space(char c);
+static inline bool is_ident(char c);
+static inline bool is_brace_stop(char c);
+static const char *scalar_space(const char *chars);
+static const char *scalar_ident(const char *chars);
+static const char *scalar_quote(const char *chars);
+static const char *scalar_line(const char *chars);
+static const char *scalar_comment(const char *chars);
+static const char *scalar_brace(const char *chars);
+
+#ifdef SCANNER_SSE2
+static inline int first_bit(unsigned int mask);
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi);
+static inline unsigned int sse2_space_mask(__m128i v);
+static inline unsigned int sse2_ident_mask(__m128i v);
+static const char *sse2_space(const char *chars);
+static const char *sse2_ident(const char *chars);
+static const char *sse2_quote(const char *chars);
+static const char *sse2_line(const char *chars);
+static const char *sse2_comment(const char *chars);
+static const char *sse2_brace(const char *chars);
+#endif
+
+#ifdef SCANNER_AVX2
+static inline bool cpu_has_avx2(void);
+TARGET_AVX2 static inline __m256i avx2_in_range(__m256i v, char lo, char hi);
+TARGET_AVX2 static inline unsigned int avx2_space_mask(__m256i v);
+TARGET_AVX2 static inline unsigned int avx2_ident_mask(__m256i v);
+TARGET_AVX2 static const char *avx2_space(const char *chars);
+TARGET_AVX2 static const char *avx2_ident(const char *chars);
+TARGET_AVX2 static const char *avx2_quote(const char *chars);
+TARGET_AVX2 static const char *avx2_line(const char *chars);
+TARGET_AVX2 static const char *avx2_comment(const char *chars);
+TARGET_AVX2 static const char *avx2_brace(const char *chars);
+#endif
+
+static inline bool is_space(char c)
+{
+  return c == ' ' || (unsigned char) (c - '\t') <= '\r' - '\t';
+}
+
+static inline bool is_ident(char c)
+{
+  return (unsigned char) (c - '0') <= 9
+      || (unsigned char) ((c | 0x20) - 'a') <= 'z' - 'a'
+      || c == '_';
+}
+
+static inline bool is_brace_stop(char c)
+{
+  // Braces, and the characters that may start a literal or a comment.
+  return c == '{' || c == '}' || c == '\"' || c == '\'' || c == '/'
+      || c == '\0';
+}
+
+static const char *scalar_space(const char *chars)
+{
+  while (is_space(*chars))
+    ++chars;
+  return chars;
+}
+
+static const char *scalar_ident(const char *chars)
+{
+  while (is_ident(*chars))
+    ++chars;
+  return chars;
+}
+
+static const char *scalar_quote(const char *chars)
+{
+  while (*chars != '\"' && *chars != '\0')
+    ++chars;
+  return chars;
+}
+
+static const char *scalar_line(const char *chars)
+{
+  while (*chars != '\n' && *chars != '\0')
+    ++chars;
+  return chars;
+}
+
+static const char *scalar_comment(const char *chars)
+{
+  while (*chars != '\0' && (chars[0] != '*' || chars[1] != '/'))
+    ++chars;
+  return chars;
+}
+
+static const char *scalar_brace(const char *chars)
+{
+  while (!is_brace_stop(*chars))
+    ++chars;
+  return chars;
+}
+
+#ifdef SCANNER_SSE2
+static inline int first_bit(unsigned int mask)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int) index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi)
+{
+  __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(hi - lo)), t);
+}
+
+static inline unsigned int sse2_space_mask(__m128i v)
+{
+  __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+    sse2_in_range(v, '\t', '\r'));
+  return (unsigned int) _mm_movemask_epi8(m);
+}
+
+static inline unsigned int sse2_ident_mask(__m128i v)
+{
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i m = _mm_or_si128(sse2_in_range(v, '0', '9'),
+    _mm_or_si128(sse2_in_range(lower, 'a', 'z'),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+  return (unsigned int) _mm_movemask_epi8(m);
+}
+
+static const char *sse2_space(const char *chars)
+{
+  for (;; chars += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) chars);
+    unsigned int mask = ~sse2_space_mask(v) & 0xffff;
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+static const char *sse2_ident(const char *chars)
+{
+  for (;; chars += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) chars);
+    unsigned int mask = ~sse2_ident_mask(v) & 0xffff;
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+static const char *sse2_quote(const char *chars)
+{
+  for (;; chars += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) chars);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')),
+      _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+static const char *sse2_line(const char *chars)
+{
+  for (;; chars += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) chars);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+      _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+static const char *sse2_comment(const char *chars)
+{
+  for (;; chars += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) chars);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+      _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+    while (mask)
+    {
+      const char *end = chars + first_bit(mask);
+      if (end[0] == '\0' || end[1] == '/')
+        return end;
+      mask &= mask - 1;
+    }
+  }
+}
+
+static const char *sse2_brace(const char *chars)
+{
+  for (;; chars += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *) chars);
+    __m128i m = _mm_or_si128(
+      _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')),
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('\"'))),
+      _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')),
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('/'))),
+        _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+    unsigned int mask = (unsigned int) _mm_movemask_epi8(m);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+#endif
+
+#ifdef SCANNER_AVX2
+static inline bool cpu_has_avx2(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return info[1] & (1 << 5);
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+TARGET_AVX2 static inline __m256i avx2_in_range(__m256i v, char lo, char hi)
+{
+  __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(hi - lo)), t);
+}
+
+TARGET_AVX2 static inline unsigned int avx2_space_mask(__m256i v)
+{
+  __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+    avx2_in_range(v, '\t', '\r'));
+  return (unsigned int) _mm256_movemask_epi8(m);
+}
+
+TARGET_AVX2 static inline unsigned int avx2_ident_mask(__m256i v)
+{
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i m = _mm256_or_si256(avx2_in_range(v, '0', '9'),
+    _mm256_or_si256(avx2_in_range(lower, 'a', 'z'),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))));
+  return (unsigned int) _mm256_movemask_epi8(m);
+}
+
+TARGET_AVX2 static const char *avx2_space(const char *chars)
+{
+  for (;; chars += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) chars);
+    unsigned int mask = ~avx2_space_mask(v);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+TARGET_AVX2 static const char *avx2_ident(const char *chars)
+{
+  for (;; chars += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) chars);
+    unsigned int mask = ~avx2_ident_mask(v);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+TARGET_AVX2 static const char *avx2_quote(const char *chars)
+{
+  for (;; chars += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) chars);
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')),
+      _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+TARGET_AVX2 static const char *avx2_line(const char *chars)
+{
+  for (;; chars += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) chars);
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+      _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+
+TARGET_AVX2 static const char *avx2_comment(const char *chars)
+{
+  for (;; chars += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) chars);
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+      _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+    while (mask)
+    {
+      const char *end = chars + first_bit(mask);
+      if (end[0] == '\0' || end[1] == '/')
+        return end;
+      mask &= mask - 1;
+    }
+  }
+}
+
+TARGET_AVX2 static const char *avx2_brace(const char *chars)
+{
+  for (;; chars += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *) chars);
+    __m256i m = _mm256_or_si256(
+      _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')),
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"'))),
+      _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')),
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))),
+        _mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+    unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+    if (mask)
+      return chars + first_bit(mask);
+  }
+}
+#endif
+
+ScannerKind scanner_detect(void)
+{
+#ifdef SCANNER_AVX2
+  if (cpu_has_avx2())
+    return SCANNER_KIND_AVX2;
+#endif
+#ifdef SCANNER_SSE2
+  return SCANNER_KIND_SSE2;
+#else
+  return SCANNER_KIND_SCALAR;
+#endif
+}
+
+void scanner_init(Scanner *scan, ScannerKind kind)
+{
+  ScannerKind best = scanner_detect();
+  if (kind > best)
+    kind = best;
+  scan->kind = kind;
+  switch (kind)
+  {
+#ifdef SCANNER_AVX2
+  case SCANNER_KIND_AVX2:
+    scan->space = avx2_space;
+    scan->ident = avx2_ident;
+    scan->quote = avx2_quote;
+    scan->line = avx2_line;
+    scan->comment = avx2_comment;
+    scan->brace = avx2_brace;
+    return;
+#endif
+#ifdef SCANNER_SSE2
+  case SCANNER_KIND_SSE2:
+    scan->space = sse2_space;
+    scan->ident = sse2_ident;
+    scan->quote = sse2_quote;
+    scan->line = sse2_line;
+    scan->comment = sse2_comment;
+    scan->brace = sse2_brace;
+    return;
+#endif
+  default:
+    break;
+  }
+  scan->space = scalar_space;
+  scan->ident = scalar_ident;
+  scan->quote = scalar_quote;
+  scan->line = scalar_line;
+  scan->comment = scalar_comment;
+  scan->brace = scalar_brace;
+}
@@ -0,0 +1,41 @@
+//
+// scanner.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+// Scanners may read up to SCANNER_WIDTH - 1 bytes past the NUL that
+// terminates the input, so the input must be padded accordingly.
+#define SCANNER_WIDTH 32
+
+typedef enum
+{
+  SCANNER_KIND_SCALAR,
+  SCANNER_KIND_SSE2,
+  SCANNER_KIND_AVX2
+} ScannerKind;
+
+typedef const char *(*ScanFn)(const char *chars);
+
+typedef struct
+{
+  ScannerKind kind;
+  ScanFn space;
+  ScanFn ident;
+  ScanFn quote;
+  ScanFn line;
+  ScanFn comment;
+  ScanFn brace;
+} Scanner;
+
+ScannerKind scanner_detect(void);
+void scanner_init(Scanner *scan, ScannerKind kind);
+
+#endif // SCANNER_H
@@ -0,0 +1,495 @@
+//
+// server.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "server.h"
+#include <stdlib.h>
+#include <string.h>
+#include "module.h"
+
+#ifndef _WIN32
+  #include <errno.h>
+  #include <signal.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/time.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+#define SERVER_MIN_CAPACITY (1 << 2)
+#define SERVER_MAX_MODULES  (1 << 16)
+#define SERVER_TIMEOUT_SECS 10
+
+// Modules are kept in one graph per set of options, and, when imports are
+// followed, per directory of the first root, which non-relative imports are
+// resolved against. A graph keeps every module it has met; once the graphs
+// hold more than SERVER_MAX_MODULES modules in all, the least recently used
+// ones are dropped whole.
+typedef struct
+{
+  int         flags;
+  bool        modules;
+  char        *dir;
+  uint64_t    used;
+  ModuleGraph graph;
+} ServerGraph;
+
+typedef struct
+{
+  int         threadCount;
+  uint64_t    clock;
+  int         capacity;
+  int         count;
+  ServerGraph **graphs;
+} Server;
+
+#ifndef _WIN32
+
+static volatile sig_atomic_t stopped = 0;
+
+static void on_signal(int sig);
+static inline bool read_all(int fd, void *ptr, size_t size);
+static inline bool write_all(int fd, const void *ptr, size_t size);
+static inline bool copy_all(int fd, uint64_t length, FILE *stream);
+static inline int open_socket(const char *socketPath,
+  struct sockaddr_un *addr);
+static inline void server_init(Server *server, int threadCount);
+static inline void server_deinit(Server *server);
+static inline void set_timeouts(int fd);
+static inline void free_graph(ServerGraph *entry);
+static inline ServerGraph *find_graph(Server *server,
+  const ServerRequest *req, const char *file);
+static inline void evict_graphs(Server *server);
+static inline void print_module(Module *module, const ServerRequest *req,
+  Buffer *out);
+static inline void write_diags(Module *module, Buffer *err);
+static inline bool compile(Server *server, const ServerRequest *req,
+  char **files, Buffer *out, Buffer *err);
+static inline void handle(Server *server, int fd);
+
+static void on_signal(int sig)
+{
+  (void) sig;
+  stopped = 1;
+}
+
+static inline bool read_all(int fd, void *ptr, size_t size)
+{
+  char *chars = ptr;
+  while (size)
+  {
+    ssize_t n = read(fd, chars, size);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    chars += n;
+    size -= (size_t) n;
+  }
+  return true;
+}
+
+static inline bool write_all(int fd, const void *ptr, size_t size)
+{
+  const char *chars = ptr;
+  while (size)
+  {
+    ssize_t n = write(fd, chars, size);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    chars += n;
+    size -= (size_t) n;
+  }
+  return true;
+}
+
+static inline bool copy_all(int fd, uint64_t length, FILE *stream)
+{
+  char chunk[1 << 14];
+  while (length)
+  {
+    size_t size = length < sizeof(chunk) ? (size_t) length : sizeof(chunk);
+    if (!read_all(fd, chunk, size))
+      return false;
+    fwrite(chunk, 1, size, stream);
+    length -= size;
+  }
+  return true;
+}
+
+static inline int open_socket(const char *socketPath,
+  struct sockaddr_un *addr)
+{
+  size_t length = strlen(socketPath);
+  if (length >= sizeof(addr->sun_path))
+    return -1;
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, socketPath, length + 1);
+  return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+static inline void set_timeouts(int fd)
+{
+  // A client that stalls gives up its turn instead of holding the server.
+  struct timeval timeout = {
+    .tv_sec = SERVER_TIMEOUT_SECS,
+    .tv_usec = 0
+  };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static inline void server_init(Server *server, int threadCount)
+{
+  int capacity = SERVER_MIN_CAPACITY;
+  server->threadCount = threadCount;
+  server->clock = 0;
+  server->capacity = capacity;
+  server->count = 0;
+  server->graphs = malloc(sizeof(*server->graphs) * capacity);
+}
+
+static inline void server_deinit(Server *server)
+{
+  for (int i = 0; i < server->count; ++i)
+    free_graph(server->graphs[i]);
+  free(server->graphs);
+}
+
+static inline void free_graph(ServerGraph *entry)
+{
+  module_graph_deinit(&entry->graph);
+  free(entry->dir);
+  free(entry);
+}
+
+static inline ServerGraph *find_graph(Server *server,
+  const ServerRequest *req, const char *file)
+{
+  bool modules = req->modules;
+  int dirLength = 0;
+  if (modules && file)
+  {
+    const char *slash = strrchr(file, '/');
+    dirLength = slash ? (int) (slash - file) + 1 : 0;
+  }
+  for (int i = 0; i < server->count; ++i)
+  {
+    ServerGraph *entry = server->graphs[i];
+    if (entry->flags == req->flags && entry->modules == modules
+      && (int) strlen(entry->dir) == dirLength
+      && !strncmp(entry->dir, file ? file : "", dirLength))
+    {
+      entry->used = ++server->clock;
+      return entry;
+    }
+  }
+  if (server->count == server->capacity)
+  {
+    int capacity = server->capacity << 1;
+    server->graphs = realloc(server->graphs,
+      sizeof(*server->graphs) * capacity);
+    server->capacity = capacity;
+  }
+  ServerGraph *entry = malloc(sizeof(*entry));
+  entry->flags = req->flags;
+  entry->modules = modules;
+  entry->dir = malloc(dirLength + 1);
+  memcpy(entry->dir, file ? file : "", dirLength);
+  entry->dir[dirLength] = '\0';
+  entry->used = ++server->clock;
+  module_graph_init(&entry->graph, req->flags);
+  entry->graph.followImports = modules;
+  server->graphs[server->count++] = entry;
+  return entry;
+}
+
+static inline void evict_graphs(Server *server)
+{
+  // The graph used last is always kept, however large it is.
+  for (;;)
+  {
+    int total = 0;
+    int oldest = 0;
+    for (int i = 0; i < server->count; ++i)
+    {
+      ServerGraph *entry = server->graphs[i];
+      total += entry->graph.count;
+      if (entry->used < server->graphs[oldest]->used)
+        oldest = i;
+    }
+    if (total <= SERVER_MAX_MODULES || server->count < 2)
+      return;
+    free_graph(server->graphs[oldest]);
+    server->graphs[oldest] = server->graphs[--server->count];
+  }
+}
+
+static inline void print_module(Module *module, const ServerRequest *req,
+  Buffer *out)
+{
+  AstPrintFormat format = (AstPrintFormat) req->format;
+  char *text = lexer_text(&module->parser.lex);
+  if (!req->flat)
+  {
+    ast_print_buffer(module->ast, text, format, out);
+    return;
+  }
+  AstFlat flat;
+  ast_flat_init(&flat);
+  ast_flatten(&flat, module->ast);
+  ast_flat_print_buffer(&flat, text, format, out);
+  ast_flat_deinit(&flat);
+}
+
+static inline void write_diags(Module *module, Buffer *err)
+{
+  DiagList *diags = &module->parser.diags;
+  for (int i = 0; i < diags->count; ++i)
+    diag_write_buffer(&diags->items[i], err);
+}
+
+static inline bool compile(Server *server, const ServerRequest *req,
+  char **files, Buffer *out, Buffer *err)
+{
+  // Answers as the command line would, except that only the modules that
+  // changed since the last request are parsed again.
+  int fileCount = req->fileCount;
+  ServerGraph *entry = find_graph(server, req, fileCount ? files[0] : NULL);
+  ModuleGraph *graph = &entry->graph;
+  module_graph_refresh(graph);
+  int *roots = malloc(sizeof(*roots) * (fileCount ? fileCount : 1));
+  int failedRoot = -1;
+  for (int i = 0; i < fileCount; ++i)
+  {
+    roots[i] = module_graph_add_root(graph, files[i]);
+    if (roots[i] == -1 && failedRoot == -1)
+      failedRoot = i;
+  }
+  module_graph_parse(graph, server->threadCount);
+  bool failed = false;
+  if (!req->modules)
+  {
+    for (int i = 0; i < fileCount; ++i)
+    {
+      if (roots[i] == -1)
+      {
+        buffer_format(err, "\nERROR: cannot open file %s\n", files[i]);
+        failed = true;
+        continue;
+      }
+      Module *module = graph->modules[roots[i]];
+      write_diags(module, err);
+      if (module->parser.diags.count)
+      {
+        failed = true;
+        continue;
+      }
+      print_module(module, req, out);
+    }
+    free(roots);
+    return !failed;
+  }
+  if (failedRoot != -1)
+  {
+    buffer_format(err, "\nERROR: cannot open file %s\n", files[failedRoot]);
+    free(roots);
+    return false;
+  }
+  int *order = malloc(sizeof(*order) * (graph->count ? graph->count : 1));
+  int count = module_graph_order(graph, fileCount, roots, order);
+  for (int i = 0; i < count; ++i)
+  {
+    Module *module = graph->modules[order[i]];
+    if (!module->ast)
+      continue;
+    write_diags(module, err);
+    failed = failed || module->parser.diags.count;
+  }
+  if (!failed)
+    for (int i = 0; i < count; ++i)
+    {
+      Module *module = graph->modules[order[i]];
+      if (module->ast)
+        print_module(module, req, out);
+    }
+  free(order);
+  free(roots);
+  return !failed;
+}
+
+static inline void handle(Server *server, int fd)
+{
+  ServerRequest req;
+  if (!read_all(fd, &req, sizeof(req)) || req.fileCount < 0
+    || req.fileCount > SERVER_MAX_FILES)
+    return;
+  if (req.format != AST_PRINT_FORMAT_TEXT && req.format != AST_PRINT_FORMAT_JSON)
+    return;
+  Buffer paths;
+  buffer_init(&paths);
+  int count = 0;
+  while (count < req.fileCount)
+  {
+    char chunk[1 << 12];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+    {
+      free(paths.data);
+      return;
+    }
+    for (ssize_t i = 0; i < n; ++i)
+      count += !chunk[i];
+    buffer_write(&paths, (size_t) n, chunk);
+  }
+  char **files = malloc(sizeof(*files) * ((size_t) req.fileCount + 1));
+  size_t offset = 0;
+  for (int i = 0; i < req.fileCount; ++i)
+  {
+    files[i] = &paths.data[offset];
+    offset += strlen(files[i]) + 1;
+  }
+  Buffer out;
+  Buffer err;
+  buffer_init(&out);
+  buffer_init(&err);
+  bool ok = compile(server, &req, files, &out, &err);
+  ServerReply reply = {
+    .status = ok ? EXIT_SUCCESS : EXIT_FAILURE,
+    .outLength = out.count,
+    .errLength = err.count
+  };
+  if (write_all(fd, &reply, sizeof(reply)) && write_all(fd, out.data, out.count))
+    write_all(fd, err.data, err.count);
+  free(out.data);
+  free(err.data);
+  free(files);
+  free(paths.data);
+}
+
+bool server_run(const char *socketPath, int threadCount)
+{
+  // Runs until interrupted or terminated. A socket file left by a server
+  // that is no longer running is replaced, but a live one is not, and
+  // neither is a file that is not a socket.
+  struct sockaddr_un addr;
+  int fd = open_socket(socketPath, &addr);
+  if (fd == -1)
+    return false;
+  if (!connect(fd, (struct sockaddr *) &addr, sizeof(addr)))
+  {
+    close(fd);
+    return false;
+  }
+  close(fd);
+  struct stat st;
+  if (!lstat(socketPath, &st))
+  {
+    if (!S_ISSOCK(st.st_mode))
+      return false;
+    unlink(socketPath);
+  }
+  fd = open_socket(socketPath, &addr);
+  if (fd == -1 || bind(fd, (struct sockaddr *) &addr, sizeof(addr))
+    || listen(fd, SOMAXCONN))
+  {
+    if (fd != -1)
+      close(fd);
+    return false;
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  Server server;
+  server_init(&server, threadCount);
+  while (!stopped)
+  {
+    int client = accept(fd, NULL, NULL);
+    if (client == -1)
+      continue;
+    set_timeouts(client);
+    handle(&server, client);
+    close(client);
+    evict_graphs(&server);
+  }
+  server_deinit(&server);
+  close(fd);
+  unlink(socketPath);
+  return true;
+}
+
+bool server_send(const char *socketPath, const ServerRequest *req,
+  char **files, FILE *out, FILE *err, int *status)
+{
+  // Paths are made absolute, since the server runs in a directory of its
+  // own. A path that cannot be resolved is sent as is, for the server to
+  // report.
+  struct sockaddr_un addr;
+  int fd = open_socket(socketPath, &addr);
+  if (fd == -1)
+    return false;
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)))
+  {
+    close(fd);
+    return false;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  bool ok = write_all(fd, req, sizeof(*req));
+  for (int i = 0; ok && i < req->fileCount; ++i)
+  {
+    char *path = realpath(files[i], NULL);
+    char *file = path ? path : files[i];
+    ok = write_all(fd, file, strlen(file) + 1);
+    free(path);
+  }
+  ServerReply reply;
+  ok = ok && read_all(fd, &reply, sizeof(reply))
+    && copy_all(fd, reply.outLength, out)
+    && copy_all(fd, reply.errLength, err);
+  close(fd);
+  fflush(out);
+  fflush(err);
+  if (ok)
+    *status = reply.status;
+  return ok;
+}
+
+#else
+
+bool server_run(const char *socketPath, int threadCount)
+{
+  // Unix sockets are not available here.
+  (void) socketPath;
+  (void) threadCount;
+  return false;
+}
+
+bool server_send(const char *socketPath, const ServerRequest *req,
+  char **files, FILE *out, FILE *err, int *status)
+{
+  (void) socketPath;
+  (void) req;
+  (void) files;
+  (void) out;
+  (void) err;
+  (void) status;
+  return false;
+}
+
+#endif
@@ -0,0 +1,45 @@
+//
+// server.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SERVER_MAX_FILES (1 << 20)
+
+// A request is this header followed by the paths of the files, each ended
+// by a null character. It is answered with a reply header followed by the
+// output and then the diagnostics. Client and server run on the same
+// machine, so headers are sent as they are laid out in memory.
+typedef struct
+{
+  int32_t flags;
+  int32_t format;
+  int32_t flat;
+  int32_t modules;
+  int32_t fileCount;
+} ServerRequest;
+
+typedef struct
+{
+  int32_t  status;
+  uint32_t reserved;
+  uint64_t outLength;
+  uint64_t errLength;
+} ServerReply;
+
+bool server_run(const char *socketPath, int threadCount);
+bool server_send(const char *socketPath, const ServerRequest *req,
+  char **files, FILE *out, FILE *err, int *status);
+
+#endif // SERVER_H
@@ -0,0 +1,131 @@
+//
+// source.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define SOURCE_MMAP
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef SOURCE_MMAP
+static inline bool map_file(Source *src, const char *file);
+#endif
+static inline bool read_file(Source *src, const char *file);
+
+#ifdef SOURCE_MMAP
+static inline bool map_file(Source *src, const char *file)
+{
+  // The file is checked before it is opened, since a pipe that was opened
+  // and closed unread would lose what its writer sent.
+  struct stat st;
+  if (stat(file, &st) == -1 || !S_ISREG(st.st_mode) || !st.st_size)
+    return false;
+  int fd = open(file, O_RDONLY);
+  if (fd == -1)
+    return false;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || !st.st_size)
+  {
+    close(fd);
+    return false;
+  }
+  // Reserve the file pages plus one zero page, then map the file over the
+  // start of the reservation. The tail of the last file page and the page
+  // after it read as zeros, which provides the lexer's padding for free.
+  size_t length = (size_t) st.st_size;
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t mapLength = (length + page - 1) & ~(page - 1);
+  size_t size = mapLength + page;
+  char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+  {
+    close(fd);
+    return false;
+  }
+  char *chars = mmap(base, mapLength, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  close(fd);
+  if (chars == MAP_FAILED)
+  {
+    munmap(base, size);
+    return false;
+  }
+  src->chars = chars;
+  src->length = length;
+  src->size = size;
+  src->mapped = true;
+  return true;
+}
+#endif
+
+static inline bool read_file(Source *src, const char *file)
+{
+  FILE *fp = NULL;
+#ifdef _WIN32
+  fopen_s(&fp, file, "r");
+#else
+  fp = fopen(file, "r");
+#endif
+  if (!fp)
+    return false;
+  // Pipes and other files without a size are read until their end, growing
+  // the buffer as it fills up.
+  size_t size = (1 << 12) + LEXER_PADDING;
+  char *chars = malloc(size);
+  size_t length = 0;
+  for (;;)
+  {
+    length += fread(&chars[length], 1, size - LEXER_PADDING - length, fp);
+    if (length < size - LEXER_PADDING)
+      break;
+    size = ((size - LEXER_PADDING) << 1) + LEXER_PADDING;
+    chars = realloc(chars, size);
+  }
+  bool ok = !ferror(fp);
+  fclose(fp);
+  if (!ok)
+  {
+    free(chars);
+    return false;
+  }
+  memset(&chars[length], 0, size - length);
+  src->chars = chars;
+  src->length = length;
+  src->size = size;
+  src->mapped = false;
+  return true;
+}
+
+bool source_load(Source *src, const char *file)
+{
+#ifdef SOURCE_MMAP
+  if (map_file(src, file))
+    return true;
+#endif
+  return read_file(src, file);
+}
+
+void source_unload(Source *src)
+{
+#ifdef SOURCE_MMAP
+  if (src->mapped)
+  {
+    munmap(src->chars, src->size);
+    return;
+  }
+#endif
+  free(src->chars);
+}
@@ -0,0 +1,28 @@
+//
+// source.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct
+{
+  char   *chars;
+  size_t length;
+  size_t size;
+  bool   mapped;
+} Source;
+
+bool source_load(Source *src, const char *file);
+void source_unload(Source *src);
+
+#endif // SOURCE_H
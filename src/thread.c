@@ -0,0 +1,163 @@
+//
+// thread.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "thread.h"
+#include <stdlib.h>
+
+#ifndef _WIN32
+  #include <unistd.h>
+#endif
+
+typedef struct
+{
+  ThreadFn fn;
+  void     *data;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg);
+#else
+static void *thread_main(void *arg);
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg)
+#else
+static void *thread_main(void *arg)
+#endif
+{
+  ThreadStart start = *(ThreadStart *) arg;
+  free(arg);
+  start.fn(start.data);
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+int thread_cpu_count(void)
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int count = (int) info.dwNumberOfProcessors;
+#else
+  int count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return count > 0 ? count : 1;
+}
+
+bool thread_start(Thread *thread, ThreadFn fn, void *data)
+{
+  ThreadStart *start = malloc(sizeof(*start));
+  start->fn = fn;
+  start->data = data;
+#ifdef _WIN32
+  *thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+  bool ok = *thread != NULL;
+#else
+  bool ok = !pthread_create(thread, NULL, thread_main, start);
+#endif
+  if (!ok)
+    free(start);
+  return ok;
+}
+
+void thread_join(Thread thread)
+{
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+void mutex_init(Mutex *mutex)
+{
+#ifdef _WIN32
+  InitializeCriticalSection(mutex);
+#else
+  pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutex_deinit(Mutex *mutex)
+{
+#ifdef _WIN32
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+void mutex_lock(Mutex *mutex)
+{
+#ifdef _WIN32
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutex_unlock(Mutex *mutex)
+{
+#ifdef _WIN32
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+void cond_init(Cond *cond)
+{
+#ifdef _WIN32
+  InitializeConditionVariable(cond);
+#else
+  pthread_cond_init(cond, NULL);
+#endif
+}
+
+void cond_deinit(Cond *cond)
+{
+#ifdef _WIN32
+  (void) cond;
+#else
+  pthread_cond_destroy(cond);
+#endif
+}
+
+void cond_wait(Cond *cond, Mutex *mutex)
+{
+#ifdef _WIN32
+  SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+  pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void cond_signal(Cond *cond)
+{
+#ifdef _WIN32
+  WakeConditionVariable(cond);
+#else
+  pthread_cond_signal(cond);
+#endif
+}
+
+void cond_broadcast(Cond *cond)
+{
+#ifdef _WIN32
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
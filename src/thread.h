@@ -0,0 +1,47 @@
+//
+// thread.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE             Thread;
+typedef CRITICAL_SECTION   Mutex;
+typedef CONDITION_VARIABLE Cond;
+#else
+typedef pthread_t          Thread;
+typedef pthread_mutex_t    Mutex;
+typedef pthread_cond_t     Cond;
+#endif
+
+typedef void (*ThreadFn)(void *data);
+
+int thread_cpu_count(void);
+bool thread_start(Thread *thread, ThreadFn fn, void *data);
+void thread_join(Thread thread);
+void mutex_init(Mutex *mutex);
+void mutex_deinit(Mutex *mutex);
+void mutex_lock(Mutex *mutex);
+void mutex_unlock(Mutex *mutex);
+void cond_init(Cond *cond);
+void cond_deinit(Cond *cond);
+void cond_wait(Cond *cond, Mutex *mutex);
+void cond_signal(Cond *cond);
+void cond_broadcast(Cond *cond);
+
+#endif // THREAD_H
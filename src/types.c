@@ -0,0 +1,171 @@
+//
+// types.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "types.h"
+#include <stdlib.h>
+
+static inline uint32_t hash_word(uint32_t hash, uint32_t word);
+static inline uint32_t hash_leaf(AstNodeKind kind, uint32_t symbol);
+static inline uint32_t hash_nonleaf(AstNodeKind kind, int count,
+  AstNode **children);
+static inline bool leaf_equals(AstNode *node, AstNodeKind kind,
+  uint32_t symbol);
+static inline bool nonleaf_equals(AstNode *node, AstNodeKind kind, int count,
+  AstNode **children);
+static inline void insert(TypeTable *table, uint32_t index, uint32_t hash,
+  AstNode *node);
+static inline void grow(TypeTable *table);
+
+static inline uint32_t hash_word(uint32_t hash, uint32_t word)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    hash ^= (uint8_t) (word >> (i << 3));
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static inline uint32_t hash_leaf(AstNodeKind kind, uint32_t symbol)
+{
+  uint32_t hash = hash_word(2166136261u, (uint32_t) kind);
+  return hash_word(hash, symbol);
+}
+
+static inline uint32_t hash_nonleaf(AstNodeKind kind, int count,
+  AstNode **children)
+{
+  uint32_t hash = hash_word(2166136261u, (uint32_t) kind);
+  for (int i = 0; i < count; ++i)
+  {
+    uint64_t addr = (uint64_t) (uintptr_t) children[i];
+    hash = hash_word(hash, (uint32_t) addr);
+    hash = hash_word(hash, (uint32_t) (addr >> 32));
+  }
+  return hash;
+}
+
+static inline bool leaf_equals(AstNode *node, AstNodeKind kind,
+  uint32_t symbol)
+{
+  if (node->kind != kind)
+    return false;
+  AstLeafNode *leaf = (AstLeafNode *) node;
+  return leaf->value.symbol == symbol;
+}
+
+static inline bool nonleaf_equals(AstNode *node, AstNodeKind kind, int count,
+  AstNode **children)
+{
+  if (node->kind != kind)
+    return false;
+  AstNonLeafNode *nonleaf = (AstNonLeafNode *) node;
+  if (nonleaf->count != count)
+    return false;
+  for (int i = 0; i < count; ++i)
+    if (nonleaf->children[i] != children[i])
+      return false;
+  return true;
+}
+
+static inline void insert(TypeTable *table, uint32_t index, uint32_t hash,
+  AstNode *node)
+{
+  int id = table->count;
+  table->hashes[id] = hash;
+  table->nodes[id] = node;
+  table->slots[index] = (uint32_t) id + 1;
+  ++table->count;
+  if (table->count << 1 >= table->capacity)
+    grow(table);
+}
+
+static inline void grow(TypeTable *table)
+{
+  int capacity = table->capacity << 1;
+  uint32_t mask = (uint32_t) capacity - 1;
+  uint32_t *slots = calloc(capacity, sizeof(*slots));
+  for (int i = 0; i < table->count; ++i)
+  {
+    uint32_t index = table->hashes[i] & mask;
+    while (slots[index])
+      index = (index + 1) & mask;
+    slots[index] = (uint32_t) i + 1;
+  }
+  free(table->slots);
+  table->capacity = capacity;
+  table->slots = slots;
+  // Nodes never outnumber half of the slots.
+  table->hashes = realloc(table->hashes,
+    sizeof(*table->hashes) * (capacity >> 1));
+  table->nodes = realloc(table->nodes, sizeof(*table->nodes) * (capacity >> 1));
+}
+
+void type_table_init(TypeTable *table)
+{
+  int capacity = TYPE_TABLE_MIN_CAPACITY;
+  table->capacity = capacity;
+  table->slots = calloc(capacity, sizeof(*table->slots));
+  table->count = 0;
+  table->hashes = malloc(sizeof(*table->hashes) * (capacity >> 1));
+  table->nodes = malloc(sizeof(*table->nodes) * (capacity >> 1));
+}
+
+void type_table_deinit(TypeTable *table)
+{
+  free(table->slots);
+  free(table->hashes);
+  free(table->nodes);
+}
+
+AstNode *type_table_leaf(TypeTable *table, Arena *arena, AstNodeKind kind,
+  Token token, TokenValue value)
+{
+  uint32_t symbol = value.symbol;
+  uint32_t hash = hash_leaf(kind, symbol);
+  uint32_t mask = (uint32_t) table->capacity - 1;
+  uint32_t index = hash & mask;
+  for (;;)
+  {
+    uint32_t slot = table->slots[index];
+    if (!slot)
+      break;
+    AstNode *node = table->nodes[slot - 1];
+    if (table->hashes[slot - 1] == hash && leaf_equals(node, kind, symbol))
+      return node;
+    index = (index + 1) & mask;
+  }
+  AstNode *node = (AstNode *) ast_leaf_node_new(arena, kind, token, value);
+  insert(table, index, hash, node);
+  return node;
+}
+
+AstNode *type_table_nonleaf(TypeTable *table, Arena *arena, AstNodeKind kind,
+  int count, AstNode **children)
+{
+  uint32_t hash = hash_nonleaf(kind, count, children);
+  uint32_t mask = (uint32_t) table->capacity - 1;
+  uint32_t index = hash & mask;
+  for (;;)
+  {
+    uint32_t slot = table->slots[index];
+    if (!slot)
+      break;
+    AstNode *node = table->nodes[slot - 1];
+    if (table->hashes[slot - 1] == hash
+     && nonleaf_equals(node, kind, count, children))
+      return node;
+    index = (index + 1) & mask;
+  }
+  AstNode *node = (AstNode *) ast_nonleaf_node_new_with_children(arena, kind,
+    count, children);
+  insert(table, index, hash, node);
+  return node;
+}
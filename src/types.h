@@ -0,0 +1,40 @@
+//
+// types.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <stdint.h>
+#include "ast.h"
+
+#define TYPE_TABLE_MIN_CAPACITY (1 << 8)
+
+// Hash-consing of type expressions. Children are interned before their
+// parent, so a node is identified by its kind and the addresses of its
+// children, or by its symbol for a leaf. Each distinct type then exists
+// once, and two types are equal exactly when their nodes are. A shared
+// node keeps the token of its first occurrence.
+typedef struct
+{
+  int      capacity;
+  uint32_t *slots;
+  int      count;
+  uint32_t *hashes;
+  AstNode  **nodes;
+} TypeTable;
+
+void type_table_init(TypeTable *table);
+void type_table_deinit(TypeTable *table);
+AstNode *type_table_leaf(TypeTable *table, Arena *arena, AstNodeKind kind,
+  Token token, TokenValue value);
+AstNode *type_table_nonleaf(TypeTable *table, Arena *arena, AstNodeKind kind,
+  int count, AstNode **children);
+
+#endif // TYPES_H
@@ -0,0 +1,114 @@
+//
+// visit.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include "visit.h"
+#include <stdlib.h>
+
+static inline AstVisitResult call(AstVisitFn *table, AstNode *node, int depth,
+  void *data);
+static inline AstVisitResult enter(AstVisitor *visitor, AstNode *node,
+  int depth);
+static inline void push(AstVisitor *visitor, AstNonLeafNode *node);
+
+static inline AstVisitResult call(AstVisitFn *table, AstNode *node, int depth,
+  void *data)
+{
+  AstVisitFn fn = table[node->kind];
+  return fn ? fn(node, depth, data) : AST_VISIT_CONTINUE;
+}
+
+static inline AstVisitResult enter(AstVisitor *visitor, AstNode *node,
+  int depth)
+{
+  AstVisitResult result = call(visitor->pre, node, depth, visitor->data);
+  if (result != AST_VISIT_CONTINUE)
+    return result;
+  if (!ast_node_is_leaf(node->kind))
+  {
+    push(visitor, (AstNonLeafNode *) node);
+    return AST_VISIT_CONTINUE;
+  }
+  return call(visitor->post, node, depth, visitor->data);
+}
+
+static inline void push(AstVisitor *visitor, AstNonLeafNode *node)
+{
+  if (visitor->count == visitor->capacity)
+  {
+    int newCapacity = visitor->capacity << 1;
+    visitor->frames = realloc(visitor->frames,
+      sizeof(*visitor->frames) * newCapacity);
+    visitor->capacity = newCapacity;
+  }
+  AstVisitFrame *frame = &visitor->frames[visitor->count];
+  frame->node = node;
+  frame->next = 0;
+  ++visitor->count;
+}
+
+void ast_visitor_init(AstVisitor *visitor, void *data)
+{
+  for (int i = 0; i < AST_NODE_KIND_COUNT; ++i)
+  {
+    visitor->pre[i] = NULL;
+    visitor->post[i] = NULL;
+  }
+  visitor->data = data;
+  int capacity = AST_VISIT_MIN_DEPTH;
+  visitor->capacity = capacity;
+  visitor->count = 0;
+  visitor->frames = malloc(sizeof(*visitor->frames) * capacity);
+}
+
+void ast_visitor_deinit(AstVisitor *visitor)
+{
+  free(visitor->frames);
+}
+
+void ast_visitor_on(AstVisitor *visitor, AstNodeKind kind, AstVisitFn pre,
+  AstVisitFn post)
+{
+  visitor->pre[kind] = pre;
+  visitor->post[kind] = post;
+}
+
+void ast_visitor_on_all(AstVisitor *visitor, AstVisitFn pre, AstVisitFn post)
+{
+  for (int i = 0; i < AST_NODE_KIND_COUNT; ++i)
+    ast_visitor_on(visitor, (AstNodeKind) i, pre, post);
+}
+
+bool ast_visit(AstVisitor *visitor, AstNode *ast)
+{
+  visitor->count = 0;
+  if (!ast)
+    return true;
+  if (enter(visitor, ast, 0) == AST_VISIT_STOP)
+    return false;
+  while (visitor->count)
+  {
+    int depth = visitor->count;
+    AstVisitFrame *frame = &visitor->frames[depth - 1];
+    AstNonLeafNode *node = frame->node;
+    if (frame->next == node->count)
+    {
+      --visitor->count;
+      AstVisitResult result = call(visitor->post, (AstNode *) node, depth - 1,
+        visitor->data);
+      if (result == AST_VISIT_STOP)
+        return false;
+      continue;
+    }
+    AstNode *child = node->children[frame->next++];
+    if (child && enter(visitor, child, depth) == AST_VISIT_STOP)
+      return false;
+  }
+  return true;
+}
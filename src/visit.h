@@ -0,0 +1,57 @@
+//
+// visit.h
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#ifndef VISIT_H
+#define VISIT_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+#define AST_VISIT_MIN_DEPTH (1 << 6)
+
+typedef enum
+{
+  AST_VISIT_CONTINUE,
+  AST_VISIT_SKIP,
+  AST_VISIT_STOP
+} AstVisitResult;
+
+typedef AstVisitResult (*AstVisitFn)(AstNode *node, int depth, void *data);
+
+typedef struct
+{
+  AstNonLeafNode *node;
+  int            next;
+} AstVisitFrame;
+
+// Walks a tree in depth-first order over an explicit stack, so depth is
+// only bounded by memory. Callbacks are looked up by node kind: pre runs
+// before the children of a node and post after them. Returning
+// AST_VISIT_SKIP from pre skips the children and the post callback of the
+// node, and AST_VISIT_STOP from either ends the walk. Absent children are
+// not visited.
+typedef struct
+{
+  AstVisitFn    pre[AST_NODE_KIND_COUNT];
+  AstVisitFn    post[AST_NODE_KIND_COUNT];
+  void          *data;
+  int           capacity;
+  int           count;
+  AstVisitFrame *frames;
+} AstVisitor;
+
+void ast_visitor_init(AstVisitor *visitor, void *data);
+void ast_visitor_deinit(AstVisitor *visitor);
+void ast_visitor_on(AstVisitor *visitor, AstNodeKind kind, AstVisitFn pre,
+  AstVisitFn post);
+void ast_visitor_on_all(AstVisitor *visitor, AstVisitFn pre, AstVisitFn post);
+bool ast_visit(AstVisitor *visitor, AstNode *ast);
+
+#endif // VISIT_H
@@ -0,0 +1,66 @@
+//
+// flatten.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "context.h"
+
+#define FLATTEN_TERMS 400000
+
+static inline bool check_deep_tree(void);
+
+static inline bool check_deep_tree(void)
+{
+  // A long chain of additions nests one level per term, deep enough to
+  // overflow the call stack of a recursive walk.
+  Buffer src;
+  buffer_init(&src);
+  buffer_format(&src, "const x = 1");
+  for (int i = 1; i < FLATTEN_TERMS; ++i)
+    buffer_format(&src, "+1");
+  buffer_format(&src, ";\n");
+  Context ctx;
+  context_init(&ctx, 0);
+  ContextStatus status = context_parse_string(&ctx, "deep", src.data,
+    src.count);
+  free(src.data);
+  if (status != CONTEXT_STATUS_OK)
+  {
+    fprintf(stderr, "deep tree: %s\n", context_status_name(status));
+    context_deinit(&ctx);
+    return false;
+  }
+  AstFlat flat;
+  ast_flat_init(&flat);
+  ast_flatten(&flat, ctx.ast);
+  Buffer tree;
+  Buffer flatTree;
+  buffer_init(&tree);
+  buffer_init(&flatTree);
+  ast_print_buffer(ctx.ast, context_text(&ctx), AST_PRINT_FORMAT_JSON, &tree);
+  ast_flat_print_buffer(&flat, context_text(&ctx), AST_PRINT_FORMAT_JSON,
+    &flatTree);
+  bool ok = tree.count == flatTree.count
+    && !memcmp(tree.data, flatTree.data, tree.count);
+  if (!ok)
+    fprintf(stderr, "deep tree: flat encoding differs from the tree\n");
+  free(tree.data);
+  free(flatTree.data);
+  ast_flat_deinit(&flat);
+  context_deinit(&ctx);
+  return ok;
+}
+
+int main(void)
+{
+  return check_deep_tree() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,140 @@
+//
+// relex.c
+// 
+// Copyright 2024 The PowerC Authors and Contributors.
+// 
+// This file is part of the PowerC Project.
+// For detailed license information, please refer to the LICENSE file
+// located in the root directory of this project.
+//
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "source.h"
+
+#define RELEX_SEEDS      300
+#define RELEX_MAX_DELETE 4
+#define RELEX_MAX_INSERT 4
+
+static const char alphabet[] = "\"'/*\n 1.ax{}";
+
+static inline uint32_t next_random(uint64_t *state);
+static inline char *pad(const char *chars, size_t length);
+static inline void free_stream(TokenStream *stream);
+static inline bool same_streams(TokenStream *a, TokenStream *b);
+static inline bool check_edit(const Source *src, uint64_t seed);
+
+static inline uint32_t next_random(uint64_t *state)
+{
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return (uint32_t) ((x * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+static inline char *pad(const char *chars, size_t length)
+{
+  char *padded = calloc(length + LEXER_PADDING, 1);
+  memcpy(padded, chars, length);
+  return padded;
+}
+
+static inline void free_stream(TokenStream *stream)
+{
+  free(stream->kinds);
+  free(stream->tokens);
+  free(stream->values);
+}
+
+static inline bool same_streams(TokenStream *a, TokenStream *b)
+{
+  int count = a->count;
+  return count == b->count
+    && !memcmp(a->kinds, b->kinds, sizeof(*a->kinds) * count)
+    && !memcmp(a->tokens, b->tokens, sizeof(*a->tokens) * count)
+    && !memcmp(a->values, b->values, sizeof(*a->values) * count);
+}
+
+static inline bool check_edit(const Source *src, uint64_t seed)
+{
+  // Applies one random edit, relexes the old stream and compares it with
+  // a stream tokenized from scratch.
+  uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+  size_t length = src->length;
+  uint32_t offset = next_random(&state) % (uint32_t) (length + 1);
+  uint32_t deleted = next_random(&state) % (RELEX_MAX_DELETE + 1);
+  if (deleted > length - offset)
+    deleted = (uint32_t) (length - offset);
+  uint32_t inserted = next_random(&state) % (RELEX_MAX_INSERT + 1);
+  size_t newLength = length - deleted + inserted;
+  char *chars = malloc(newLength + 1);
+  memcpy(chars, src->chars, offset);
+  for (uint32_t i = 0; i < inserted; ++i)
+    chars[offset + i] = alphabet[next_random(&state) % (sizeof(alphabet) - 1)];
+  memcpy(&chars[offset + inserted], &src->chars[offset + deleted],
+    length - offset - deleted);
+  char *oldSource = pad(src->chars, length);
+  char *newSource = pad(chars, newLength);
+  free(chars);
+  Interner interner;
+  interner_init(&interner);
+  DiagList diags;
+  diag_init(&diags);
+  Lexer lex;
+  lexer_init(&lex, "old", oldSource, &interner, &diags);
+  TokenStream relexed;
+  lexer_tokenize(&lex, &relexed);
+  LexerEdit edit = {
+    .offset = offset,
+    .deleted = deleted,
+    .inserted = inserted
+  };
+  lexer_relex(&lex, &relexed, newSource, edit);
+  lexer_deinit(&lex);
+  lexer_init(&lex, "new", newSource, &interner, &diags);
+  TokenStream fresh;
+  lexer_tokenize(&lex, &fresh);
+  lexer_deinit(&lex);
+  bool ok = same_streams(&relexed, &fresh);
+  if (!ok)
+    fprintf(stderr, "relex mismatch: seed %" PRIu64 ", offset %u, deleted %u,"
+      " inserted %u\n", seed, offset, deleted, inserted);
+  free_stream(&relexed);
+  free_stream(&fresh);
+  diag_deinit(&diags);
+  interner_deinit(&interner);
+  free(oldSource);
+  free(newSource);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  // Every input file gets the same seeds.
+  int failed = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    Source src;
+    if (!source_load(&src, argv[i]))
+    {
+      fprintf(stderr, "cannot open file %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+    for (uint64_t seed = 0; seed < RELEX_SEEDS; ++seed)
+      failed += !check_edit(&src, seed);
+    source_unload(&src);
+  }
+  if (failed)
+  {
+    fprintf(stderr, "%d edit(s) relexed differently\n", failed);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}